@@ -2,6 +2,8 @@
 
 
 #include "Actors/RogueTrainTrack.h"
+#include "Async/ParallelFor.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "Components/SplineComponent.h"
 #include "Components/SplineMeshComponent.h"
 #include "Data/RogueDeveloperSettings.h"
@@ -28,6 +30,25 @@ void ARogueTrainTrack::BuildTrackMeshes()
 	
 	if (!TrainTrackMesh || !SplineComponent) return;
 
+	TArray<FTrackSpan> Spans;
+	BuildSpans(Spans);
+
+	if (BuildMode == ERogueTrackBuildMode::Instanced)
+	{
+		BuildInstancedTrack(Spans);
+		return;
+	}
+
+	for (const FTrackSpan& Span : Spans)
+	{
+		AddSplineMesh(Span.StartPos, Span.StartDir, Span.EndPos, Span.EndDir);
+	}
+}
+
+void ARogueTrainTrack::BuildSpans(TArray<FTrackSpan>& OutSpans) const
+{
+	OutSpans.Reset();
+	
 	const int32 NumPoints = SplineComponent->GetNumberOfSplinePoints();
 	if (NumPoints < 2) return;
 
@@ -38,21 +59,13 @@ void ARogueTrainTrack::BuildTrackMeshes()
 	//const int32 NumSegments = FMath::RoundToInt(Length / MeshLength);
 	const int32 NumSegments = FMath::Max(1, static_cast<int32>(FMath::CeilToFloat((bClosed ? Length : (Length - (SpanLen - StepLen))) / StepLen)));
 
-
-	for (int32 i = 0; i < NumSegments; ++i)
+	// Spline evaluation is read only, sample every span on worker threads
+	OutSpans.SetNumUninitialized(NumSegments);
+	ParallelFor(NumSegments, [&](const int32 i)
 	{
-		//const int32 StartIdx = SegIdx;
-		//const int32 EndIdx = (SegIdx + 1) % NumPoints;
-		//const float StartDist = (SegIdx * Length) / NumSegments;
-		//const float EndDistance = ((SegIdx + 1) * Length) / NumSegments;
-
 		float StartDist = i * StepLen;
-
-		// In open splines, stop if a full span would start beyond the end.
-		if (!bClosed && StartDist >= Length)
-			break;
-
 		float EndDist = StartDist + SpanLen;
+		float MidDist = StartDist + 0.5f * SpanLen;
 
 		// Wrap/clamp distances
 		if (bClosed)
@@ -61,43 +74,117 @@ void ARogueTrainTrack::BuildTrackMeshes()
 			auto Wrap = [&](float d){ d = FMath::Fmod(d, Length); return (d < 0.f) ? d + Length : d; };
 			StartDist = Wrap(StartDist);
 			EndDist   = Wrap(EndDist);
+			MidDist   = Wrap(MidDist);
 		}
 		else
 		{
 			EndDist = FMath::Min(EndDist, Length);
+			MidDist = 0.5f * (StartDist + EndDist);
+		}
+
+		FTrackSpan& Span = OutSpans[i];
+		Span.StartPos = SplineComponent->GetLocationAtDistanceAlongSpline(StartDist, ESplineCoordinateSpace::Local);
+		Span.EndPos = SplineComponent->GetLocationAtDistanceAlongSpline(EndDist, ESplineCoordinateSpace::Local);
+		Span.StartDir = SplineComponent->GetDirectionAtDistanceAlongSpline(StartDist, ESplineCoordinateSpace::Local);
+		Span.EndDir = SplineComponent->GetDirectionAtDistanceAlongSpline(EndDist, ESplineCoordinateSpace::Local);
+		Span.MidUp = SplineComponent->GetUpVectorAtDistanceAlongSpline(MidDist, ESplineCoordinateSpace::Local);
+	});
+}
+
+void ARogueTrainTrack::BuildInstancedTrack(const TArray<FTrackSpan>& Spans)
+{
+	const FBox MeshBounds = TrainTrackMesh->GetBoundingBox();
+	const float MeshMinX = MeshBounds.Min.X;
+	const float MeshLengthX = FMath::Max(1.f, MeshBounds.GetSize().X);
+	const float StraightCos = FMath::Cos(FMath::DegreesToRadians(StraightToleranceDegrees));
+	const float MergeCos = FMath::Cos(FMath::DegreesToRadians(MaxMergedTurnDegrees));
+
+	// Classify spans and build the instance transforms on worker threads, straight spans stretch the mesh X extent over the chord
+	TArray<uint8> Straight;
+	TArray<FTransform> Transforms;
+	Straight.SetNumZeroed(Spans.Num());
+	Transforms.SetNum(Spans.Num());
+	ParallelFor(Spans.Num(), [&](const int32 i)
+	{
+		const FTrackSpan& Span = Spans[i];
+		const FVector Chord = Span.EndPos - Span.StartPos;
+		const FVector ChordDir = Chord.GetSafeNormal();
+		if ((Span.StartDir | Span.EndDir) < StraightCos || (Span.StartDir | ChordDir) < StraightCos) return;
+
+		const FQuat Rotation = FRotationMatrix::MakeFromXZ(ChordDir, Span.MidUp).ToQuat();
+		const FVector Scale(Chord.Size() / MeshLengthX, TrainTrackScale, TrainTrackScale);
+		Transforms[i] = FTransform(Rotation, Span.StartPos - Rotation.RotateVector(FVector(MeshMinX * Scale.X, 0.f, 0.f)), Scale);
+		Straight[i] = 1;
+	});
+
+	TArray<FTransform> InstanceTransforms;
+	InstanceTransforms.Reserve(Spans.Num());
+	for (int32 i = 0; i < Spans.Num(); ++i)
+	{
+		if (Straight[i])
+		{
+			InstanceTransforms.Add(Transforms[i]);
+			continue;
 		}
 
-		const FVector StartPos = SplineComponent->GetLocationAtDistanceAlongSpline(StartDist, ESplineCoordinateSpace::Local);
-		const FVector EndPos = SplineComponent->GetLocationAtDistanceAlongSpline(EndDist, ESplineCoordinateSpace::Local);
-		const FVector StartDir = SplineComponent->GetDirectionAtDistanceAlongSpline(StartDist, ESplineCoordinateSpace::Local);
-		const FVector EndDir = SplineComponent->GetDirectionAtDistanceAlongSpline(EndDist, ESplineCoordinateSpace::Local);
-
-		const float ChordLen = (EndPos - StartPos).Size();
-		const FVector StartTangent = StartDir * (ChordLen * 0.5f);
-		const FVector EndTangent = EndDir * (ChordLen * 0.5f);
-
-		USplineMeshComponent* MeshComponent = NewObject<USplineMeshComponent>(this);
-		MeshComponent->SetMobility(EComponentMobility::Static);
-		MeshComponent->AttachToComponent(SplineComponent, FAttachmentTransformRules::KeepRelativeTransform);
-		MeshComponent->SetRelativeTransform(FTransform::Identity); 
-		MeshComponent->SetStaticMesh(TrainTrackMesh);
-		MeshComponent->SetForwardAxis(ESplineMeshAxis::X);
-		MeshComponent->SetStartAndEnd(StartPos, StartTangent, EndPos, EndTangent);
-		MeshComponent->SetStartScale(FVector2D(TrainTrackScale, TrainTrackScale));
-		MeshComponent->SetEndScale  (FVector2D(TrainTrackScale, TrainTrackScale));
-		MeshComponent->SetStartRoll(0.f);
-		MeshComponent->SetEndRoll(0.f);		
-		MeshComponent->bSmoothInterpRollScale = true;
-
-		if (TrackMaterial)
+		// Merge a run of curved spans into one spline mesh while the run stays shallow
+		int32 RunEnd = i;
+		while (RunEnd + 1 < Spans.Num() && !Straight[RunEnd + 1] && (RunEnd + 1 - i) < MaxMergedSpans
+			&& (Spans[i].StartDir | Spans[RunEnd + 1].EndDir) >= MergeCos)
 		{
-			MeshComponent->SetMaterial(0, TrackMaterial);
+			++RunEnd;
 		}
 
-		MeshComponent->RegisterComponent();
-		TrackSegments.Add(MeshComponent);
-        AddInstanceComponent(MeshComponent);
+		AddSplineMesh(Spans[i].StartPos, Spans[i].StartDir, Spans[RunEnd].EndPos, Spans[RunEnd].EndDir);
+		i = RunEnd;
+	}
+
+	if (InstanceTransforms.Num() == 0) return;
+
+	TrackInstances = NewObject<UInstancedStaticMeshComponent>(this);
+	TrackInstances->SetMobility(EComponentMobility::Static);
+	TrackInstances->AttachToComponent(SplineComponent, FAttachmentTransformRules::KeepRelativeTransform);
+	TrackInstances->SetRelativeTransform(FTransform::Identity);
+	TrackInstances->SetStaticMesh(TrainTrackMesh);
+
+	if (TrackMaterial)
+	{
+		TrackInstances->SetMaterial(0, TrackMaterial);
 	}
+
+	TrackInstances->AddInstances(InstanceTransforms, /*bShouldReturnIndices*/ false, /*bWorldSpace*/ false);
+	TrackInstances->RegisterComponent();
+	AddInstanceComponent(TrackInstances);
+}
+
+USplineMeshComponent* ARogueTrainTrack::AddSplineMesh(const FVector& StartPos, const FVector& StartDir, const FVector& EndPos, const FVector& EndDir)
+{
+	const float ChordLen = (EndPos - StartPos).Size();
+	const FVector StartTangent = StartDir * (ChordLen * 0.5f);
+	const FVector EndTangent = EndDir * (ChordLen * 0.5f);
+
+	USplineMeshComponent* MeshComponent = NewObject<USplineMeshComponent>(this);
+	MeshComponent->SetMobility(EComponentMobility::Static);
+	MeshComponent->AttachToComponent(SplineComponent, FAttachmentTransformRules::KeepRelativeTransform);
+	MeshComponent->SetRelativeTransform(FTransform::Identity); 
+	MeshComponent->SetStaticMesh(TrainTrackMesh);
+	MeshComponent->SetForwardAxis(ESplineMeshAxis::X);
+	MeshComponent->SetStartAndEnd(StartPos, StartTangent, EndPos, EndTangent);
+	MeshComponent->SetStartScale(FVector2D(TrainTrackScale, TrainTrackScale));
+	MeshComponent->SetEndScale  (FVector2D(TrainTrackScale, TrainTrackScale));
+	MeshComponent->SetStartRoll(0.f);
+	MeshComponent->SetEndRoll(0.f);		
+	MeshComponent->bSmoothInterpRollScale = true;
+
+	if (TrackMaterial)
+	{
+		MeshComponent->SetMaterial(0, TrackMaterial);
+	}
+
+	MeshComponent->RegisterComponent();
+	TrackSegments.Add(MeshComponent);
+	AddInstanceComponent(MeshComponent);
+	return MeshComponent;
 }
 
 void ARogueTrainTrack::ClearTrackMeshes()
@@ -109,5 +196,10 @@ void ARogueTrainTrack::ClearTrackMeshes()
 	}
 	
 	TrackSegments.Reset();
-}
 
+	if (TrackInstances)
+	{
+		TrackInstances->DestroyComponent();
+		TrackInstances = nullptr;
+	}
+}
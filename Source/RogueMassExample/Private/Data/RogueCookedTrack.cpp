@@ -0,0 +1,304 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Data/RogueCookedTrack.h"
+#include "Components/SplineComponent.h"
+#include "Async/MappedFileHandle.h"
+#include "Data/RogueDeveloperSettings.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace RogueCookedTrack
+{
+	constexpr int32 SectionAlignment = 16;
+	// Lower bound for one serialized station: the six platform vectors plus the waiting, spawn and grid slot array counts
+	constexpr int64 MinStationBytes = 6 * sizeof(FVector) + 3 * sizeof(int32);
+
+	// A loaded count is only trusted if the smallest possible encoding of that many items fits in what is left
+	bool HasBytesFor(FArchive& Ar, const int32 Num, const int64 MinItemBytes)
+	{
+		return Num >= 0 && static_cast<int64>(Num) * MinItemBytes <= Ar.TotalSize() - Ar.Tell();
+	}
+
+	// Same layout as TArray's operator<<, but a bad count fails the archive before anything is allocated
+	template <typename T, typename FuncType>
+	void SerializeArray(FArchive& Ar, TArray<T>& Items, const int64 MinItemBytes, FuncType&& SerializeItem)
+	{
+		int32 Num = Items.Num();
+		Ar << Num;
+		if (Ar.IsLoading())
+		{
+			if (Ar.IsError() || !HasBytesFor(Ar, Num, MinItemBytes))
+			{
+				Ar.SetError();
+				return;
+			}
+			Items.SetNum(Num);
+		}
+
+		for (int32 i = 0; i < Items.Num() && !Ar.IsError(); ++i)
+		{
+			SerializeItem(Ar, Items[i]);
+		}
+	}
+
+	void SerializeVectors(FArchive& Ar, TArray<FVector>& Vectors)
+	{
+		SerializeArray(Ar, Vectors, sizeof(FVector), [](FArchive& ItemAr, FVector& Vector) { ItemAr << Vector; });
+	}
+
+	void SerializeGridSlots(FArchive& Ar, TArray<TArray<FVector>>& Slots)
+	{
+		SerializeArray(Ar, Slots, sizeof(int32), [](FArchive& ItemAr, TArray<FVector>& Vectors) { SerializeVectors(ItemAr, Vectors); });
+	}
+
+	void SerializePlatform(FArchive& Ar, FRoguePlatformData& Platform)
+	{
+		uint8 Side = static_cast<uint8>(Platform.TrackSide);
+		
+		Ar << Platform.Start << Platform.End;
+		Ar << Platform.Center << Platform.Fwd << Platform.Right << Platform.Up;
+		Ar << Platform.DockAlpha << Platform.DockDistance << Platform.TrackOffset << Platform.PlatformLength << Side;
+		Ar << Platform.World << Platform.Alpha << Platform.ConfigIndex;
+		SerializeVectors(Ar, Platform.WaitingPoints);
+		SerializeVectors(Ar, Platform.SpawnPoints);
+		Ar << Platform.WaitingGridConfig.GridCols << Platform.WaitingGridConfig.GridRows;
+		Ar << Platform.WaitingGridConfig.GridColSpacing << Platform.WaitingGridConfig.GridRowSpacing;
+		Ar << Platform.WaitingGridConfig.GridEdgeInset << Platform.WaitingGridConfig.GridOffset;
+
+		Platform.TrackSide = static_cast<EPlatformSide>(Side);
+	}
+
+	template <typename T>
+	TConstArrayView<T> MakeSectionView(const uint8* Base, const int64 FileSize, const uint64 Offset, const uint32 Num)
+	{
+		if (Offset + static_cast<uint64>(Num) * sizeof(T) > static_cast<uint64>(FileSize)) return TConstArrayView<T>();
+		return TConstArrayView<T>(reinterpret_cast<const T*>(Base + Offset), Num);
+	}
+
+	template <typename T>
+	void AppendSection(TArray<uint8>& Bytes, const TConstArrayView<T> Items, uint64& OutOffset)
+	{
+		Bytes.SetNumZeroed(Align(Bytes.Num(), SectionAlignment));
+		OutOffset = Bytes.Num();
+		Bytes.Append(reinterpret_cast<const uint8*>(Items.GetData()), Items.Num() * sizeof(T));
+	}
+}
+
+FRogueCookedTrack::~FRogueCookedTrack()
+{
+	// Region must go before the handle it was mapped from
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+uint32 FRogueCookedTrack::ComputeSourceHash(const USplineComponent& Spline, const URogueDeveloperSettings& Settings)
+{
+	uint32 Crc = 0;
+	auto Hash = [&Crc](const auto& Value) { Crc = FCrc::MemCrc32(&Value, sizeof(Value), Crc); };
+
+	Hash(Settings.TrackSplineResampleStep);
+	Hash(Settings.TrackSampleStep);
+	Hash(Settings.Stations.Num());
+	for (const FRogueStationConfig& Station : Settings.Stations)
+	{
+		const FRoguePlatformConfig& Platform = Station.PlatformConfig;
+		const FRogueStationWaitingGridConfig& Grid = Station.WaitingGridConfig;
+		
+		Hash(Station.TrackAlpha);
+		Hash(Platform.PlatformLength); Hash(Platform.TrackOffset); Hash(Platform.VerticalOffset);
+		Hash(Platform.SpawnPointDistance); Hash(Platform.WaitingPoints); Hash(Platform.SpawnPoints);
+		Hash(static_cast<uint8>(Platform.Side));
+		Hash(Grid.GridCols); Hash(Grid.GridRows); Hash(Grid.GridColSpacing);
+		Hash(Grid.GridRowSpacing); Hash(Grid.GridEdgeInset); Hash(Grid.GridOffset);
+	}
+
+	const FTransform ComponentTransform = Spline.GetComponentTransform();
+	Hash(ComponentTransform.GetLocation());
+	Hash(ComponentTransform.GetRotation());
+	Hash(ComponentTransform.GetScale3D());
+	Hash(static_cast<uint8>(Spline.IsClosedLoop()));
+	
+	const int32 NumPoints = Spline.GetNumberOfSplinePoints();
+	Hash(NumPoints);
+	for (int32 i = 0; i < NumPoints; ++i)
+	{
+		Hash(Spline.GetLocationAtSplinePoint(i, ESplineCoordinateSpace::Local));
+		Hash(Spline.GetArriveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local));
+		Hash(Spline.GetLeaveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local));
+		Hash(Spline.GetRotationAtSplinePoint(i, ESplineCoordinateSpace::Local));
+		Hash(Spline.GetScaleAtSplinePoint(i));
+		Hash(static_cast<uint8>(Spline.GetSplinePointType(i)));
+	}
+
+	return Crc;
+}
+
+FString FRogueCookedTrack::GetFilename(const URogueDeveloperSettings& Settings)
+{
+	return FPaths::Combine(FPaths::ProjectContentDir(), Settings.CookedTrackFile);
+}
+
+TUniquePtr<FRogueCookedTrack> FRogueCookedTrack::Load(const FString& Filename, const uint32 ExpectedSourceHash)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Filename)) return nullptr;
+
+	FOpenMappedResult MappedResult = PlatformFile.OpenMappedEx(*Filename);
+	if (MappedResult.HasError())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cooked track %s could not be memory-mapped: %s"), *Filename, *MappedResult.GetError().GetMessage());
+		return nullptr;
+	}
+
+	TUniquePtr<FRogueCookedTrack> Cooked(new FRogueCookedTrack());
+	Cooked->MappedFile = MappedResult.StealValue();
+
+	const int64 FileSize = Cooked->MappedFile->GetFileSize();
+	if (FileSize < static_cast<int64>(sizeof(FRogueCookedTrackHeader))) return nullptr;
+
+	Cooked->MappedRegion.Reset(Cooked->MappedFile->MapRegion(0, FileSize, EMappedFileFlags::EPreloadHint));
+	if (!Cooked->MappedRegion) return nullptr;
+
+	const uint8* Base = Cooked->MappedRegion->GetMappedPtr();
+	FMemory::Memcpy(&Cooked->Header, Base, sizeof(FRogueCookedTrackHeader));
+
+	const FRogueCookedTrackHeader& Header = Cooked->Header;
+	if (Header.Magic != FileMagic || Header.Version != FileVersion
+		|| Header.PointStride != sizeof(FRogueCookedSplinePoint) || Header.SampleStride != sizeof(FRogueTrackSample))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cooked track %s has an incompatible version or layout, rebake it"), *Filename);
+		return nullptr;
+	}
+	
+	if (Header.SourceHash != ExpectedSourceHash)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cooked track %s is stale, rebake it"), *Filename);
+		return nullptr;
+	}
+
+	Cooked->Points = RogueCookedTrack::MakeSectionView<FRogueCookedSplinePoint>(Base, FileSize, Header.PointsOffset, Header.NumPoints);
+	Cooked->Samples = RogueCookedTrack::MakeSectionView<FRogueTrackSample>(Base, FileSize, Header.SamplesOffset, Header.NumSamples);
+	if (Cooked->Points.Num() != static_cast<int32>(Header.NumPoints) || Cooked->Samples.Num() != static_cast<int32>(Header.NumSamples)) return nullptr;
+	if (Header.StationsOffset + Header.StationsSize > static_cast<uint64>(FileSize) || Header.StationsSize > static_cast<uint64>(MAX_int32)) return nullptr;
+
+	// Station data is variable sized, deserialize it
+	FMemoryReaderView Reader(MakeArrayView(Base + Header.StationsOffset, static_cast<int32>(Header.StationsSize)));
+	int32 NumStations = 0;
+	Reader << NumStations;
+	if (Reader.IsError() || !RogueCookedTrack::HasBytesFor(Reader, NumStations, RogueCookedTrack::MinStationBytes))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cooked track %s has a corrupt station section, rebake it"), *Filename);
+		return nullptr;
+	}
+	
+	Cooked->Platforms.SetNum(NumStations);
+	Cooked->GridSlots.SetNum(NumStations);
+	for (int32 i = 0; i < NumStations; ++i)
+	{
+		RogueCookedTrack::SerializePlatform(Reader, Cooked->Platforms[i]);
+		if (Reader.IsError()) break;
+		
+		RogueCookedTrack::SerializeGridSlots(Reader, Cooked->GridSlots[i]);
+		if (Reader.IsError()) break;
+	}
+	
+	if (Reader.IsError())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Cooked track %s has a corrupt station section, rebake it"), *Filename);
+		return nullptr;
+	}
+
+	return Cooked;
+}
+
+bool FRogueCookedTrack::Save(const FString& Filename, const uint32 SourceHash, const USplineComponent& Spline,
+	const TArray<FRoguePlatformData>& Platforms, const TArray<FRogueWaitingGrids>& Grids, const FRogueTrackSharedFragment& Track)
+{
+	if (!Track.HasSamples()) return false;
+
+	TArray<FRogueCookedSplinePoint> SplinePoints;
+	SplinePoints.SetNumZeroed(Spline.GetNumberOfSplinePoints());
+	for (int32 i = 0; i < SplinePoints.Num(); ++i)
+	{
+		FRogueCookedSplinePoint& Point = SplinePoints[i];
+		Point.Location = Spline.GetLocationAtSplinePoint(i, ESplineCoordinateSpace::Local);
+		Point.ArriveTangent = Spline.GetArriveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local);
+		Point.LeaveTangent = Spline.GetLeaveTangentAtSplinePoint(i, ESplineCoordinateSpace::Local);
+		Point.Rotation = Spline.GetRotationAtSplinePoint(i, ESplineCoordinateSpace::Local);
+		Point.Scale = Spline.GetScaleAtSplinePoint(i);
+		Point.PointType = static_cast<uint32>(Spline.GetSplinePointType(i));
+	}
+
+	FRogueCookedTrackHeader Header;
+	Header.Magic = FileMagic;
+	Header.Version = FileVersion;
+	Header.SourceHash = SourceHash;
+	Header.PointStride = sizeof(FRogueCookedSplinePoint);
+	Header.SampleStride = sizeof(FRogueTrackSample);
+	Header.NumPoints = SplinePoints.Num();
+	Header.NumSamples = Track.Samples.Num();
+	Header.bClosedLoop = Spline.IsClosedLoop() ? 1 : 0;
+	Header.SampleStep = Track.SampleStep;
+	Header.TrackLength = Track.TrackLength;
+
+	TArray<uint8> Bytes;
+	Bytes.SetNumZeroed(sizeof(FRogueCookedTrackHeader));
+	RogueCookedTrack::AppendSection<FRogueCookedSplinePoint>(Bytes, SplinePoints, Header.PointsOffset);
+	RogueCookedTrack::AppendSection<FRogueTrackSample>(Bytes, Track.Samples, Header.SamplesOffset);
+
+	Bytes.SetNumZeroed(Align(Bytes.Num(), RogueCookedTrack::SectionAlignment));
+	Header.StationsOffset = Bytes.Num();
+	{
+		FMemoryWriter Writer(Bytes, /*bIsPersistent*/ true, /*bSetOffset*/ true);
+		int32 NumStations = Platforms.Num();
+		Writer << NumStations;
+		for (int32 i = 0; i < NumStations; ++i)
+		{
+			FRoguePlatformData Platform = Platforms[i];
+			RogueCookedTrack::SerializePlatform(Writer, Platform);
+
+			TArray<TArray<FVector>> Slots;
+			if (Grids.IsValidIndex(i))
+			{
+				for (int32 Grid = 0; Grid < Grids[i].Num(); ++Grid)
+				{
+					Slots.Emplace(Grids[i].GetSlotPositions(Grid));
+				}
+			}
+			RogueCookedTrack::SerializeGridSlots(Writer, Slots);
+		}
+	}
+	Header.StationsSize = Bytes.Num() - Header.StationsOffset;
+	
+	FMemory::Memcpy(Bytes.GetData(), &Header, sizeof(FRogueCookedTrackHeader));
+	return FFileHelper::SaveArrayToFile(Bytes, *Filename);
+}
+
+void FRogueCookedTrack::ApplyToSpline(USplineComponent& Spline) const
+{
+	Spline.ClearSplinePoints(false);
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		const FRogueCookedSplinePoint& Point = Points[i];
+		Spline.AddSplinePoint(Point.Location, ESplineCoordinateSpace::Local, false);
+		Spline.SetRotationAtSplinePoint(i, Point.Rotation, ESplineCoordinateSpace::Local, false);
+		Spline.SetScaleAtSplinePoint(i, Point.Scale, false);
+
+		// Tangents first, setting them switches the point to custom tangents
+		Spline.SetTangentsAtSplinePoint(i, Point.ArriveTangent, Point.LeaveTangent, ESplineCoordinateSpace::Local, false);
+		Spline.SetSplinePointType(i, static_cast<ESplinePointType::Type>(Point.PointType), false);
+	}
+
+	Spline.SetClosedLoop(Header.bClosedLoop != 0, false);
+	Spline.UpdateSpline();
+}
+
+const TArray<FVector>* FRogueCookedTrack::GetGridSlots(const int32 StationIdx, const int32 WaitingPointIdx) const
+{
+	if (!GridSlots.IsValidIndex(StationIdx) || !GridSlots[StationIdx].IsValidIndex(WaitingPointIdx)) return nullptr;
+	return &GridSlots[StationIdx][WaitingPointIdx];
+}
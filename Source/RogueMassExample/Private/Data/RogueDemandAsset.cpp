@@ -0,0 +1,55 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Data/RogueDemandAsset.h"
+
+float URogueDemandAsset::GetTimeOfDayScale(const float WorldSeconds) const
+{
+	const float Hour = FMath::Fmod(StartHour + WorldSeconds / SecondsPerHour, 24.f);
+	return FMath::Max(0.f, TimeOfDayScale.GetRichCurveConst()->Eval(Hour, 1.f));
+}
+
+void URogueDemandAsset::BuildTables(TConstArrayView<int32> StationConfigIndices, TArray<float>& OutOriginRates, TArray<float>& OutDestinationCdf) const
+{
+	const int32 NumStations = StationConfigIndices.Num();
+	OutOriginRates.Init(0.f, NumStations);
+	OutDestinationCdf.Init(0.f, NumStations * NumStations);
+
+	// Missing entries are zero demand, still worth flagging since it is usually a station added without a matrix edit
+	bool bSizeMismatch = Origins.Num() != NumStations;
+	for (const FRogueDemandRow& Row : Origins)
+	{
+		bSizeMismatch |= Row.TripsPerHour.Num() != NumStations;
+	}
+	if (bSizeMismatch)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Demand asset %s is not %d x %d to match the station count, missing trips are treated as zero"), *GetName(), NumStations, NumStations);
+	}
+
+	const float PerSecond = DemandScale / SecondsPerHour;
+	for (int32 Origin = 0; Origin < NumStations; ++Origin)
+	{
+		const int32 OriginRow = StationConfigIndices[Origin];
+		const TArray<float>* Trips = Origins.IsValidIndex(OriginRow) ? &Origins[OriginRow].TripsPerHour : nullptr;
+		float* Cdf = OutDestinationCdf.GetData() + Origin * NumStations;
+
+		float Total = 0.f;
+		for (int32 Destination = 0; Destination < NumStations; ++Destination)
+		{
+			const int32 DestinationColumn = StationConfigIndices[Destination];
+			if (Trips && Destination != Origin && Trips->IsValidIndex(DestinationColumn))
+			{
+				Total += FMath::Max(0.f, (*Trips)[DestinationColumn]);
+			}
+			Cdf[Destination] = Total;
+		}
+
+		OutOriginRates[Origin] = Total * PerSecond;
+		if (Total <= 0.f) continue;
+
+		for (int32 Destination = 0; Destination < NumStations; ++Destination)
+		{
+			Cdf[Destination] /= Total;
+		}
+	}
+}
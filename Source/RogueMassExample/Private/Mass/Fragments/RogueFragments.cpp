@@ -2,10 +2,13 @@
 
 
 #include "Mass/Fragments/RogueFragments.h"
+#include "Algo/BinarySearch.h"
 #include "Components/SplineComponent.h"
 
 float FRogueTrackSharedFragment::GetStationAlphaByIndex(const int32 Index) const
 {
+	if (StationAlphas.IsValidIndex(Index)) return StationAlphas[Index];
+
 	const USplineComponent& TrackSpline = *Spline.Get();
 	const float SplineLength = FMath::Max(1.f, TrackSpline.GetSplineLength());
 	const FRoguePlatformData& Platform = Platforms.IsValidIndex(Index) ? Platforms[Index] : FRoguePlatformData();
@@ -13,3 +16,204 @@ float FRogueTrackSharedFragment::GetStationAlphaByIndex(const int32 Index) const
 
 	return FMath::Frac(Dist / SplineLength);
 }
+
+bool FRoguePlatformHeightField::SampleHeight(const FVector& Position, float& OutZ) const
+{
+	if (!IsValid()) return false;
+
+	const FVector Local = Position - Origin;
+	const float GridX = FVector::DotProduct(Local, AxisX) * InvCellSize;
+	const float GridY = FVector::DotProduct(Local, AxisY) * InvCellSize;
+	if (GridX < 0.f || GridY < 0.f) return false;
+
+	const int32 X0 = FMath::FloorToInt32(GridX);
+	const int32 Y0 = FMath::FloorToInt32(GridY);
+	if (X0 >= NumX - 1 || Y0 >= NumY - 1) return false;
+
+	const int32 Idx = Y0 * NumX + X0;
+	const float H00 = Heights[Idx];
+	const float H10 = Heights[Idx + 1];
+	const float H01 = Heights[Idx + NumX];
+	const float H11 = Heights[Idx + NumX + 1];
+	if (H00 == MAX_flt || H10 == MAX_flt || H01 == MAX_flt || H11 == MAX_flt) return false;
+
+	OutZ = FMath::BiLerp(H00, H10, H01, H11, GridX - X0, GridY - Y0);
+	return true;
+}
+
+void FRogueCarriageFragment::AddOccupant(const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation)
+{
+	FRogueOccupantBucket* Bucket = FindOccupantBucket(DestinationStation);
+	if (!Bucket)
+	{
+		Bucket = &OccupantBuckets.AddDefaulted_GetRef();
+		Bucket->DestinationStation = DestinationStation;
+	}
+	Bucket->Passengers.Add(Passenger);
+	++NumOccupants;
+}
+
+bool FRogueCarriageFragment::RemoveOccupant(const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation)
+{
+	FRogueOccupantBucket* Bucket = FindOccupantBucket(DestinationStation);
+	if (!Bucket || Bucket->Passengers.RemoveSwap(Passenger, EAllowShrinking::No) == 0) return false;
+	
+	--NumOccupants;
+	return true;
+}
+
+void FRogueWaitingGrids::Reset()
+{
+	SlotPositions.Reset();
+	OccupiedBy.Reset();
+	SlotStarts.Reset();
+	Occupancy.Reset();
+	ReadyMasks.Reset();
+	ReadyRing.Reset();
+	ReadyHeads.Reset();
+	ReadyCounts.Reset();
+	SlotStarts.Add(0);
+}
+
+void FRogueWaitingGrids::AddGrid(TConstArrayView<FVector> Slots)
+{
+	if (SlotStarts.Num() == 0) SlotStarts.Add(0);
+	
+	const int32 NumSlots = FMath::Min(Slots.Num(), MaxSlotsPerGrid);
+	UE_CLOG(NumSlots < Slots.Num(), LogTemp, Warning, TEXT("Waiting grid %d has %d slots, only the first %d are kept"), Num(), Slots.Num(), MaxSlotsPerGrid);
+	SlotPositions.Append(Slots.GetData(), NumSlots);
+	OccupiedBy.AddDefaulted(NumSlots);
+	SlotStarts.Add(SlotPositions.Num());
+	Occupancy.Add(0);
+	ReadyMasks.Add(0);
+	ReadyRing.AddZeroed(MaxSlotsPerGrid);
+	ReadyHeads.Add(0);
+	ReadyCounts.Add(0);
+}
+
+int32 FRogueWaitingGrids::Claim(const int32 Grid, const FMassEntityHandle Passenger)
+{
+	if (!IsValidIndex(Grid)) return INDEX_NONE;
+
+	const int32 NumSlots = GetNumSlots(Grid);
+	const uint64 SlotMask = (NumSlots >= 64) ? MAX_uint64 : ((uint64(1) << NumSlots) - 1);
+	const uint64 Free = ~Occupancy[Grid] & SlotMask;
+	if (Free == 0) return INDEX_NONE;
+
+	const int32 Slot = static_cast<int32>(FMath::CountTrailingZeros64(Free));
+	Occupancy[Grid] |= uint64(1) << Slot;
+	OccupiedBy[SlotStarts[Grid] + Slot] = Passenger;
+	return Slot;
+}
+
+void FRogueWaitingGrids::Release(const int32 Grid, const int32 Slot)
+{
+	if (!IsValidSlotIndex(Grid, Slot)) return;
+	
+	Occupancy[Grid] &= ~(uint64(1) << Slot);
+	OccupiedBy[SlotStarts[Grid] + Slot] = FMassEntityHandle();
+
+	const uint64 Bit = uint64(1) << Slot;
+	if (!(ReadyMasks[Grid] & Bit)) return;
+	ReadyMasks[Grid] &= ~Bit;
+
+	// Boarding releases the front, anything else closes the gap in the ring
+	uint8* Ring = ReadyRing.GetData() + Grid * MaxSlotsPerGrid;
+	const int32 Head = ReadyHeads[Grid];
+	const int32 Count = ReadyCounts[Grid];
+	int32 Found = 0;
+	while (Found < Count && Ring[(Head + Found) % MaxSlotsPerGrid] != Slot) ++Found;
+	if (Found == Count) return;
+	
+	if (Found == 0)
+	{
+		ReadyHeads[Grid] = static_cast<uint8>((Head + 1) % MaxSlotsPerGrid);
+	}
+	else
+	{
+		for (int32 i = Found; i < Count - 1; ++i)
+		{
+			Ring[(Head + i) % MaxSlotsPerGrid] = Ring[(Head + i + 1) % MaxSlotsPerGrid];
+		}
+	}
+	--ReadyCounts[Grid];
+}
+
+bool FRogueWaitingGrids::PushReady(const int32 Grid, const int32 Slot)
+{
+	if (!IsValidSlotIndex(Grid, Slot)) return false;
+
+	const uint64 Bit = uint64(1) << Slot;
+	if (!(Occupancy[Grid] & Bit) || (ReadyMasks[Grid] & Bit)) return false;
+
+	// One entry per occupied slot at most, so the ring never overflows
+	ReadyRing[Grid * MaxSlotsPerGrid + (ReadyHeads[Grid] + ReadyCounts[Grid]) % MaxSlotsPerGrid] = static_cast<uint8>(Slot);
+	++ReadyCounts[Grid];
+	ReadyMasks[Grid] |= Bit;
+	return true;
+}
+
+void FRoguePlatformLineIndex::Build(const TArray<FVector>& Points, const FVector& InOrigin, const FVector& InAxis)
+{
+	Origin = InOrigin;
+	Axis = InAxis.GetSafeNormal();
+	
+	PointIndices.SetNumUninitialized(Points.Num());
+	for (int32 i = 0; i < Points.Num(); ++i) PointIndices[i] = i;
+	PointIndices.Sort([&](const int32 A, const int32 B)
+	{
+		return FVector::DotProduct(Points[A] - Origin, Axis) < FVector::DotProduct(Points[B] - Origin, Axis);
+	});
+
+	Keys.SetNumUninitialized(Points.Num());
+	for (int32 i = 0; i < PointIndices.Num(); ++i)
+	{
+		Keys[i] = FVector::DotProduct(Points[PointIndices[i]] - Origin, Axis);
+	}
+}
+
+int32 FRoguePlatformLineIndex::FindNearest(const TArray<FVector>& Points, const FVector& From) const
+{
+	if (Keys.Num() == 0 || Keys.Num() != Points.Num()) return INDEX_NONE;
+
+	// Start either side of the projected coordinate and walk out until the gap along the axis alone can't win
+	const float Key = FVector::DotProduct(From - Origin, Axis);
+	int32 Right = Algo::LowerBound(Keys, Key);
+	int32 Left = Right - 1;
+	
+	int32 Best = INDEX_NONE;
+	float BestDistSq = TNumericLimits<float>::Max();
+	while (Left >= 0 || Right < Keys.Num())
+	{
+		const float LeftGap = (Left >= 0) ? Key - Keys[Left] : TNumericLimits<float>::Max();
+		const float RightGap = (Right < Keys.Num()) ? Keys[Right] - Key : TNumericLimits<float>::Max();
+		const bool bTakeLeft = LeftGap <= RightGap;
+		if (FMath::Square(bTakeLeft ? LeftGap : RightGap) >= BestDistSq) break;
+
+		const int32 PointIdx = PointIndices[bTakeLeft ? Left-- : Right++];
+		const float DistSq = FVector::DistSquared(Points[PointIdx], From);
+		if (DistSq < BestDistSq)
+		{
+			BestDistSq = DistSq;
+			Best = PointIdx;
+		}
+	}
+
+	return Best;
+}
+
+bool FRoguePlatformFlowFields::SampleDirection(const FRoguePlatformHeightField& Grid, const int32 Field, const FVector& Position, FVector& OutDirection) const
+{
+	if (!IsValid() || Field < 0 || Field >= NumFields || Grid.NumX * Grid.NumY != NumCells) return false;
+
+	const FVector Local = Position - Grid.Origin;
+	const int32 X = FMath::RoundToInt32(FVector::DotProduct(Local, Grid.AxisX) * Grid.InvCellSize);
+	const int32 Y = FMath::RoundToInt32(FVector::DotProduct(Local, Grid.AxisY) * Grid.InvCellSize);
+	if (X < 0 || Y < 0 || X >= Grid.NumX || Y >= Grid.NumY) return false;
+
+	const uint8 Code = Directions[Field * NumCells + Y * Grid.NumX + X];
+	if (Code == NoDirection) return false;
+
+	OutDirection = (Grid.AxisX * OffsetX[Code] + Grid.AxisY * OffsetY[Code]).GetSafeNormal();
+	return true;
+}
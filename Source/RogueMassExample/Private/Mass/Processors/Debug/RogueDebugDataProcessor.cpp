@@ -23,6 +23,7 @@ void URogueDebugDataProcessor::ConfigureQueries(const TSharedRef<FMassEntityMana
 	PassengerEntityQuery.AddRequirement<FMassMoveTargetFragment>(EMassFragmentAccess::ReadOnly);	
 	PassengerEntityQuery.AddRequirement<FRoguePassengerFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::All);	
 	PassengerEntityQuery.AddTagRequirement<FRogueTrainPassengerTag>(EMassFragmentPresence::All);
+	PassengerEntityQuery.AddTagRequirement<FRoguePooledEntityTag>(EMassFragmentPresence::None);
 	PassengerEntityQuery.AddRequirement<FRogueDebugSlotFragment>(EMassFragmentAccess::ReadOnly);
 	PassengerEntityQuery.RegisterWithProcessor(*this);	
 
@@ -190,7 +191,7 @@ void URogueDebugDataProcessor::Execute(FMassEntityManager& EntityManager, FMassE
 			DebugData.IndexInTrain = LinkFragment.CarriageIndex;
 			DebugData.Spacing = LinkFragment.Spacing;
 			DebugData.Capacity = CarriageFragment.Capacity;
-			DebugData.Occupants = CarriageFragment.Occupants.Num();
+			DebugData.Occupants = CarriageFragment.NumOccupants;
 
 			// Write to slot index
 			LocalCarriageSnap[DebugSlot] = DebugData;
@@ -233,22 +234,13 @@ void URogueDebugDataProcessor::Execute(FMassEntityManager& EntityManager, FMassE
 
 			// Queues
 			int32 TotalWaitingCount = 0;
-			int32 i = 0;
-			for (const TPair<int32, FRogueWaitingGrid>& Pair : QueueFragment.Grids)
+			for (int32 i = 0; i < QueueFragment.Grids.Num(); ++i)
 			{
-				const FRogueWaitingGrid& WaitingGrid = Pair.Value;
-				FRogueDebugWaitingGrid& GridData = DebugData.Grids[i++];
-				GridData.WaitingPointIdx = Pair.Key;
-				GridData.Slots = WaitingGrid.SlotPositions.Num();
+				FRogueDebugWaitingGrid& GridData = DebugData.Grids[i];
+				GridData.WaitingPointIdx = i;
+				GridData.Slots = QueueFragment.Grids.GetNumSlots(i);
 
-				int32 WaitingLocalGridCount = 0;
-				for (int j = 0; j < WaitingGrid.OccupiedBy.Num(); ++j)
-				{
-					if (WaitingGrid.OccupiedBy[j].IsValid())
-					{
-						WaitingLocalGridCount++;
-					}
-				}
+				const int32 WaitingLocalGridCount = QueueFragment.Grids.GetNumOccupied(i);
 
 				GridData.Free = GridData.Slots - WaitingLocalGridCount;
 				GridData.Occupied = WaitingLocalGridCount;
@@ -4,6 +4,7 @@
 #include "Mass/Processors/Passengers/RoguePassengerHeightProcessor.h"
 #include "MassCommonFragments.h"
 #include "MassExecutionContext.h"
+#include "Data/RogueDeveloperSettings.h"
 #include "Mass/Processors/Passengers/RoguePassengerMovementProcessor.h"
 #include "Utilities/RoguePassengerUtility.h"
 
@@ -17,8 +18,11 @@ URoguePassengerHeightProcessor::URoguePassengerHeightProcessor(): EntityQuery(*t
 void URoguePassengerHeightProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
 {
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
-	EntityQuery.AddRequirement<FRoguePassengerFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::All);
+	EntityQuery.AddRequirement<FRoguePassengerFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::All);
 	EntityQuery.AddTagRequirement<FRogueTrainPassengerTag>(EMassFragmentPresence::All);
+	EntityQuery.AddTagRequirement<FRoguePassengerQueuedTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FRoguePassengerRidingTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FRoguePooledEntityTag>(EMassFragmentPresence::None);
 }
 
 void URoguePassengerHeightProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
@@ -26,16 +30,46 @@ void URoguePassengerHeightProcessor::Execute(FMassEntityManager& EntityManager,
 	UWorld* WorldContext = Context.GetWorld();
 	if (!WorldContext) return;
 
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings) return;
+
+	const uint32 TraceInterval = static_cast<uint32>(FMath::Max(1, Settings->PlatformHeightTraceInterval));
+	const uint32 Frame = FrameCounter++;
+	
+	FMassEntityHandle CachedStation;
+	const FRogueStationQueueFragment* CachedQueue = nullptr;
+
 	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
 	{
 		const TArrayView<FTransformFragment> TransformFragments = SubContext.GetMutableFragmentView<FTransformFragment>();		
+		const TConstArrayView<FRoguePassengerFragment> PassengerFragments = SubContext.GetFragmentView<FRoguePassengerFragment>();
 		const int32 NumEntities = SubContext.GetNumEntities();
 		
 		for (int32 EntityIndex = 0; EntityIndex < NumEntities; EntityIndex++)
 		{
 			FTransform& PTransform = TransformFragments[EntityIndex].GetMutableTransform();
 			FVector PLocation = PTransform.GetLocation();
-			RoguePassengerUtility::SnapToPlatform(WorldContext, PLocation);
+
+			// Platform the passenger is on, origin until unloaded at the destination
+			const FRoguePassengerFragment& PassengerFragment = PassengerFragments[EntityIndex];
+			const FMassEntityHandle Station = RoguePassengerUtility::GetCurrentStation(PassengerFragment);
+			if (Station != CachedStation)
+			{
+				CachedStation = Station;
+				CachedQueue = EntityManager.IsEntityValid(Station) ? EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(Station) : nullptr;
+			}
+
+			// Grid lookup on the platform, staggered traces anywhere else
+			float Height = 0.f;
+			if (CachedQueue && CachedQueue->PlatformHeights.SampleHeight(PLocation, Height))
+			{
+				PLocation.Z = Height;
+			}
+			else if ((Frame + static_cast<uint32>(EntityIndex)) % TraceInterval == 0)
+			{
+				RoguePassengerUtility::SnapToPlatform(WorldContext, PLocation);
+			}
+			
 			PTransform.SetLocation(PLocation);
 		}
 	});
@@ -2,9 +2,12 @@
 
 
 #include "Mass/Processors/Passengers/RoguePassengerMovementProcessor.h"
+#include "MassCommandBuffer.h"
 #include "MassCommonFragments.h"
 #include "MassCommonTypes.h"
 #include "MassExecutionContext.h"
+#include "Data/RogueDeveloperSettings.h"
+#include "Subsystems/RogueRouteSubsystem.h"
 #include "Subsystems/RogueTrainWorldSubsystem.h"
 #include "Utilities/RoguePassengerUtility.h"
 #include "Utilities/RogueStationQueueUtility.h"
@@ -23,10 +26,14 @@ void URoguePassengerMovementProcessor::ConfigureQueries(const TSharedRef<FMassEn
 	EntityQuery.AddConstSharedRequirement<FMassMovementParameters>(EMassFragmentPresence::All);
 	EntityQuery.AddRequirement<FRoguePassengerFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::All);	
 	EntityQuery.AddTagRequirement<FRogueTrainPassengerTag>(EMassFragmentPresence::All);
+	EntityQuery.AddTagRequirement<FRoguePassengerQueuedTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FRoguePassengerRidingTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FRoguePooledEntityTag>(EMassFragmentPresence::None);
 	EntityQuery.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.RegisterWithProcessor(*this);	
 
 	ProcessorRequirements.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadWrite);
+	ProcessorRequirements.AddSubsystemRequirement<URogueRouteSubsystem>(EMassFragmentAccess::ReadOnly);
 }
 
 void URoguePassengerMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
@@ -37,6 +44,7 @@ void URoguePassengerMovementProcessor::Execute(FMassEntityManager& EntityManager
 	const FRogueTrackSharedFragment& TrackSharedFragment = TrainSubsystem->GetTrackShared();
 	if (!TrackSharedFragment.IsValid()) return;
 
+	const URogueRouteSubsystem& RouteSubsystem = Context.GetSubsystemChecked<URogueRouteSubsystem>();
 	const float Time = Context.GetWorld()->GetTimeSeconds();
 
 	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
@@ -71,10 +79,13 @@ void URoguePassengerMovementProcessor::Execute(FMassEntityManager& EntityManager
 				}
 			}
 
-			// If we have a move target, update movement towards it			
+			// If we have a move target, update movement towards it. Phase tags are deferred, so queued and riding
+			// passengers can still be visited for the frame they change phase.
 			if (PassengerFragment.Phase != ERoguePassengerPhase::RideOnTrain && !PassengerFragment.bWaiting)
 			{
-				MoveToTarget(PassengerFragment, MoveTarget, MoveParams, PTransform, PassengerFragment.Target);
+				FVector FlowDirection;
+				const bool bHasFlow = SampleFlowDirection(EntityManager, PassengerFragment, PTransform.GetLocation(), FlowDirection);
+				MoveToTarget(PassengerFragment, MoveTarget, MoveParams, PTransform, PassengerFragment.Target, bHasFlow ? &FlowDirection : nullptr);
 			}
 
 			// Subsystem with declared thread-safe access
@@ -83,10 +94,10 @@ void URoguePassengerMovementProcessor::Execute(FMassEntityManager& EntityManager
 			// Handle phase-specific logic, destination arrival, boarding, departing and waiting
 			switch (PassengerFragment.Phase)
 			{
-				case ERoguePassengerPhase::ToStationWaitingPoint: ToStationWaitingPoint(EntityManager, PassengerFragment, PTransform, PassengerHandle, Time); break;
-				case ERoguePassengerPhase::ToAssignedCarriage: ToAssignedCarriage(EntityManager, SubContext, PassengerFragment, PTransform, PassengerHandle); break;
+				case ERoguePassengerPhase::ToStationWaitingPoint: ToStationWaitingPoint(EntityManager, SubContext, PassengerFragment, PTransform, PassengerHandle, Time); break;
+				case ERoguePassengerPhase::ToAssignedCarriage: ToAssignedCarriage(EntityManager, TrainSubsystemMutable, SubContext, PassengerFragment, PTransform, PassengerHandle); break;
 				case ERoguePassengerPhase::RideOnTrain: break; // Riding, do nothing
-				case ERoguePassengerPhase::UnloadAtStation: UnloadAtStation(EntityManager, PassengerFragment, PTransform); break;
+				case ERoguePassengerPhase::UnloadAtStation: UnloadAtStation(EntityManager, RouteSubsystem, TrackSharedFragment, PassengerFragment, PTransform); break;
 				case ERoguePassengerPhase::ToPostUnloadWaitingPoint: ToPostUnloadWaitingPoint(EntityManager, PassengerFragment, PTransform); break;
 				case ERoguePassengerPhase::ToExitSpawn: ToExitSpawn(EntityManager, TrainSubsystemMutable, SubContext, PassengerFragment, PTransform, PassengerHandle); break;
 				default:
@@ -118,8 +129,32 @@ void URoguePassengerMovementProcessor::AssignWaitingPoint(const FMassEntityManag
 	}
 }
 
+bool URoguePassengerMovementProcessor::SampleFlowDirection(const FMassEntityManager& EntityManager, const FRoguePassengerFragment& PassengerFragment, const FVector& Location,
+	FVector& OutDirection)
+{
+	// Field for the current walk, the last stretch and carriage boarding are straight lines
+	FMassEntityHandle Station;
+	int32 Field = INDEX_NONE;
+	switch (PassengerFragment.Phase)
+	{
+		case ERoguePassengerPhase::ToStationWaitingPoint: Station = PassengerFragment.OriginStation; Field = PassengerFragment.WaitingPointIdx; break;
+		case ERoguePassengerPhase::ToPostUnloadWaitingPoint: Station = PassengerFragment.DestinationStation; Field = PassengerFragment.WaitingPointIdx; break;
+		case ERoguePassengerPhase::ToExitSpawn: Station = PassengerFragment.DestinationStation; break;
+		default: return false;
+	}
+	if (!Station.IsSet()) return false;
+
+	const auto* StationQueueFragment = EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(Station);
+	if (!StationQueueFragment || !StationQueueFragment->FlowFields.IsValid()) return false;
+
+	const FRoguePlatformFlowFields& Flow = StationQueueFragment->FlowFields;
+	if (PassengerFragment.Phase == ERoguePassengerPhase::ToExitSpawn) Field = Flow.GetExitField();
+	
+	return Flow.SampleDirection(StationQueueFragment->PlatformHeights, Field, Location, OutDirection);
+}
+
 void URoguePassengerMovementProcessor::MoveToTarget(const FRoguePassengerFragment& PassengerFragment, FMassMoveTargetFragment& MoveTarget, const FMassMovementParameters& MoveParams,
-	const FTransform& PTransform, const FVector& TargetDestination)
+	const FTransform& PTransform, const FVector& TargetDestination, const FVector* FlowDirection)
 {
 	FVector Delta  = PassengerFragment.Target - PTransform.GetLocation();
 	Delta.Z = 0.f;
@@ -130,6 +165,14 @@ void URoguePassengerMovementProcessor::MoveToTarget(const FRoguePassengerFragmen
 		MoveTarget.Center = TargetDestination;
 		MoveTarget.DistanceToGoal = DistToGoal;
 		MoveTarget.Forward = Delta.GetSafeNormal();
+
+		// Follow the flow field a short way ahead instead of cutting straight across the platform
+		if (FlowDirection)
+		{
+			constexpr float FlowLookAhead = 100.f;
+			MoveTarget.Forward = *FlowDirection;
+			MoveTarget.Center = PTransform.GetLocation() + *FlowDirection * FMath::Min(FlowLookAhead, DistToGoal);
+		}
 		
 		constexpr float SlowdownRadius = 120.f; 
 		const float t = FMath::Clamp(DistToGoal / SlowdownRadius, 0.f, 1.f);
@@ -138,7 +181,7 @@ void URoguePassengerMovementProcessor::MoveToTarget(const FRoguePassengerFragmen
 	}
 }
 
-void URoguePassengerMovementProcessor::ToStationWaitingPoint(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment,
+void URoguePassengerMovementProcessor::ToStationWaitingPoint(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
 	const FTransform& PTransform, const FMassEntityHandle PassengerHandle, const float Time)
 {
 	// Arrived? enqueue into that waiting-point queue if not already queued, idle until boarding - boarding handled by station ops processor
@@ -148,14 +191,16 @@ void URoguePassengerMovementProcessor::ToStationWaitingPoint(const FMassEntityMa
 		
 		if (auto* StationQueueFragment = EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(PassengerFragment.OriginStation))
 		{
-			RoguePassengerQueueUtility::EnqueueAtWaitingPoint(*StationQueueFragment, PassengerFragment.WaitingPointIdx, PassengerHandle, PassengerFragment.DestinationStation, Time, /*prio*/0);
+			RoguePassengerQueueUtility::EnqueueAtWaitingPoint(*StationQueueFragment, PassengerFragment.WaitingPointIdx, PassengerFragment.WaitingSlotIdx, PassengerHandle,
+				PassengerFragment.DestinationStation, Time, PassengerFragment.BoardingPriority);
 			PassengerFragment.bWaiting = true;
 			PassengerFragment.Target = PTransform.GetLocation();
+			Context.Defer().PushCommand<FMassCommandAddTag<FRoguePassengerQueuedTag>>(PassengerHandle);
 		}		
 	}
 }
 
-void URoguePassengerMovementProcessor::ToAssignedCarriage(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
+void URoguePassengerMovementProcessor::ToAssignedCarriage(const FMassEntityManager& EntityManager, URogueTrainWorldSubsystem& TrainSubsystem, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
 	 const FTransform& PTransform, const FMassEntityHandle PassengerHandle)
 {
 	// If we were boarded already, VehicleHandle is set, head to the carriage door (carriage transform)
@@ -166,23 +211,41 @@ void URoguePassengerMovementProcessor::ToAssignedCarriage(const FMassEntityManag
 			PassengerFragment.Target = CarriageTransformFragment->GetTransform().GetLocation();
 
 			if (FVector::DistSquared(PTransform.GetLocation(), PassengerFragment.Target) <= FMath::Square(PassengerFragment.AcceptanceRadius))
-			{				
+			{
+				// Collapse into the carriage destination counts and release the entity
+				const auto* Settings = GetDefault<URogueDeveloperSettings>();
+				auto* CarriageFragment = EntityManager.GetFragmentDataPtr<FRogueCarriageFragment>(PassengerFragment.VehicleHandle);
+				if (Settings && Settings->bVirtualizeRiders && CarriageFragment)
+				{
+					RoguePassengerUtility::VirtualizeRider(TrainSubsystem, Context, *CarriageFragment, PassengerHandle, PassengerFragment.DestinationStation, PassengerFragment.RouteIndex);
+					PassengerFragment.Phase = ERoguePassengerPhase::Pool;
+					PassengerFragment.VehicleHandle = FMassEntityHandle();
+					PassengerFragment.WaitingPointIdx = INDEX_NONE;
+					PassengerFragment.WaitingSlotIdx = INDEX_NONE;
+					return;
+				}
+
 				RoguePassengerUtility::HidePassenger(EntityManager, PassengerHandle);
 				PassengerFragment.Phase = ERoguePassengerPhase::RideOnTrain;
 				PassengerFragment.WaitingPointIdx = INDEX_NONE;
 				PassengerFragment.WaitingSlotIdx = INDEX_NONE;
+				Context.Defer().PushCommand<FMassCommandAddTag<FRoguePassengerRidingTag>>(PassengerHandle);
 			}
 		}
 	}
 }
 
-void URoguePassengerMovementProcessor::UnloadAtStation(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment, const FTransform& PTransform)
+void URoguePassengerMovementProcessor::UnloadAtStation(const FMassEntityManager& EntityManager, const URogueRouteSubsystem& RouteSubsystem, const FRogueTrackSharedFragment& TrackSharedFragment,
+	FRoguePassengerFragment& PassengerFragment, const FTransform& PTransform)
 {
 	if (!PassengerFragment.DestinationStation.IsValid()) return;
 
+	// Interchange, queue again here for the next leg instead of leaving
+	if (StartNextLeg(EntityManager, RouteSubsystem, TrackSharedFragment, PassengerFragment)) return;
+
 	if (const auto* StationQueueFragment = EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(PassengerFragment.DestinationStation))
 	{
-		const int32 WaitingPoint = RoguePassengerUtility::FindNearestIndex(StationQueueFragment->WaitingPoints, PTransform.GetLocation());				
+		const int32 WaitingPoint = StationQueueFragment->WaitingPointLine.FindNearest(StationQueueFragment->WaitingPoints, PTransform.GetLocation());				
 		if (StationQueueFragment->WaitingPoints.IsValidIndex(WaitingPoint))
 		{
 			PassengerFragment.WaitingPointIdx = WaitingPoint;
@@ -192,6 +255,28 @@ void URoguePassengerMovementProcessor::UnloadAtStation(const FMassEntityManager&
 	}
 }
 
+bool URoguePassengerMovementProcessor::StartNextLeg(const FMassEntityManager& EntityManager, const URogueRouteSubsystem& RouteSubsystem, const FRogueTrackSharedFragment& TrackSharedFragment,
+	FRoguePassengerFragment& PassengerFragment)
+{
+	if (PassengerFragment.RouteIndex == INDEX_NONE) return false;
+
+	const auto* StationFragment = EntityManager.GetFragmentDataPtr<FRogueStationFragment>(PassengerFragment.DestinationStation);
+	if (!StationFragment || StationFragment->StationIndex == PassengerFragment.RouteIndex) return false;
+
+	const int32 NextHop = RouteSubsystem.GetNextHop(StationFragment->StationIndex, PassengerFragment.RouteIndex);
+	const FMassEntityHandle NextStation = TrackSharedFragment.GetStationEntityByIndex(NextHop);
+	if (NextHop == StationFragment->StationIndex || !NextStation.IsSet()) return false;
+
+	// Back to the start of the passenger flow, a waiting point is assigned at this station next frame
+	PassengerFragment.OriginStation = PassengerFragment.DestinationStation;
+	PassengerFragment.DestinationStation = NextStation;
+	PassengerFragment.WaitingPointIdx = INDEX_NONE;
+	PassengerFragment.WaitingSlotIdx = INDEX_NONE;
+	PassengerFragment.bWaiting = false;
+	PassengerFragment.Phase = ERoguePassengerPhase::EnteredWorld;
+	return true;
+}
+
 void URoguePassengerMovementProcessor::ToPostUnloadWaitingPoint(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment, const FTransform& PTransform)
 {
 	if (FVector::DistSquared(PTransform.GetLocation(), PassengerFragment.Target) <= FMath::Square(PassengerFragment.AcceptanceRadius * 2.f))
@@ -199,7 +284,7 @@ void URoguePassengerMovementProcessor::ToPostUnloadWaitingPoint(const FMassEntit
 		// Immediately head to nearest exit spawn to leave the world
 		if (const auto* StationQueueFragment = EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(PassengerFragment.DestinationStation))
 		{
-			const int32 ExitIdx = RoguePassengerUtility::FindNearestIndex(StationQueueFragment->SpawnPoints, PTransform.GetLocation());			
+			const int32 ExitIdx = StationQueueFragment->SpawnPointLine.FindNearest(StationQueueFragment->SpawnPoints, PTransform.GetLocation());			
 			if (StationQueueFragment->SpawnPoints.IsValidIndex(ExitIdx))
 			{
 				PassengerFragment.Target = StationQueueFragment->SpawnPoints[ExitIdx];
@@ -0,0 +1,111 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Processors/Passengers/RoguePassengerSeparationProcessor.h"
+#include "Async/ParallelFor.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "MassMovementFragments.h"
+#include "Data/RogueDeveloperSettings.h"
+#include "Mass/Fragments/RogueFragments.h"
+#include "Utilities/RoguePassengerUtility.h"
+
+URoguePassengerSeparationProcessor::URoguePassengerSeparationProcessor(): EntityQuery(*this)
+{
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::AllNetModes);
+	ProcessingPhase = EMassProcessingPhase::PrePhysics;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Avoidance;
+}
+
+void URoguePassengerSeparationProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
+{
+	// Trains never carry the passenger tag, riding and pooled passengers are off the platform
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FAgentRadiusFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FRoguePassengerFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassForceFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddTagRequirement<FRogueTrainPassengerTag>(EMassFragmentPresence::All);
+	EntityQuery.AddTagRequirement<FRoguePassengerRidingTag>(EMassFragmentPresence::None);
+	EntityQuery.AddTagRequirement<FRoguePooledEntityTag>(EMassFragmentPresence::None);
+	EntityQuery.RegisterWithProcessor(*this);
+}
+
+void URoguePassengerSeparationProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings || !Settings->bUsePassengerSeparation) return;
+
+	// Gather positions into flat arrays, queued passengers hold their slot and only act as obstacles.
+	// Passengers only separate from others on the same platform, the station they are at scopes the hash
+	Positions.Reset();
+	Platforms.Reset();
+	Radii.Reset();
+	Movable.Reset();
+	float MaxRadius = 0.f;
+	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
+	{
+		const TConstArrayView<FTransformFragment> TransformFragments = SubContext.GetFragmentView<FTransformFragment>();
+		const TConstArrayView<FAgentRadiusFragment> RadiusFragments = SubContext.GetFragmentView<FAgentRadiusFragment>();
+		const TConstArrayView<FRoguePassengerFragment> PassengerFragments = SubContext.GetFragmentView<FRoguePassengerFragment>();
+		const bool bQueued = SubContext.DoesArchetypeHaveTag<FRoguePassengerQueuedTag>();
+
+		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
+		{
+			Positions.Add(TransformFragments[i].GetTransform().GetLocation());
+			Platforms.Add(RoguePassengerUtility::GetCurrentStation(PassengerFragments[i]).Index);
+			Radii.Add(RadiusFragments[i].Radius);
+			MaxRadius = FMath::Max(MaxRadius, RadiusFragments[i].Radius);
+			Movable.Add(!bQueued);
+		}
+	});
+
+	const int32 NumPassengers = Positions.Num();
+	if (NumPassengers <= 1) return;
+
+	SpatialHash.Build(Positions, Platforms, Settings->PassengerSeparationCellSize);
+
+	// Query neighbours in parallel, each passenger only writes its own force
+	const float Strength = Settings->PassengerSeparationStrength;
+	Forces.SetNumUninitialized(NumPassengers);
+	ParallelFor(NumPassengers, [&](const int32 Index)
+	{
+		FVector Force = FVector::ZeroVector;
+		if (Movable[Index])
+		{
+			const FVector& Location = Positions[Index];
+			const float Radius = Radii[Index];
+			
+			// Wide enough for the largest neighbour, the overlap test below uses both radii
+			SpatialHash.ForEachNearby(Platforms[Index], Location, Radius + MaxRadius, [&](const int32 Other)
+			{
+				if (Other == Index) return;
+
+				FVector Delta = Location - Positions[Other];
+				Delta.Z = 0.f; // platform plane only, heights are snapped separately
+				const float MinDist = Radius + Radii[Other];
+				const float DistSq = Delta.SizeSquared();
+				if (DistSq >= FMath::Square(MinDist)) return;
+
+				// Coincident passengers get a stable direction from their index order
+				const float Dist = FMath::Sqrt(DistSq);
+				const FVector Dir = (Dist > UE_KINDA_SMALL_NUMBER) ? Delta / Dist : FVector(Index < Other ? 1.f : -1.f, 0.f, 0.f);
+				Force += Dir * (Strength * (1.f - Dist / MinDist));
+			});
+		}
+		Forces[Index] = Force;
+	});
+
+	// Same query, same order
+	int32 Offset = 0;
+	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
+	{
+		const TArrayView<FMassForceFragment> ForceFragments = SubContext.GetMutableFragmentView<FMassForceFragment>();
+
+		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
+		{
+			ForceFragments[i].Value += Forces[Offset + i];
+		}
+		Offset += SubContext.GetNumEntities();
+	});
+}
@@ -4,8 +4,11 @@
 #include "Mass/Processors/Passengers/RoguePassengerSpawnProcessor.h"
 #include "MassCommonTypes.h"
 #include "MassExecutionContext.h"
+#include "Data/RogueDemandAsset.h"
 #include "Data/RogueDeveloperSettings.h"
+#include "Subsystems/RogueRouteSubsystem.h"
 #include "Subsystems/RogueTrainWorldSubsystem.h"
+#include "Utilities/RogueDemandUtility.h"
 
 
 URoguePassengerSpawnProcessor::URoguePassengerSpawnProcessor(): EntityQuery(*this)
@@ -13,11 +16,13 @@ URoguePassengerSpawnProcessor::URoguePassengerSpawnProcessor(): EntityQuery(*thi
 	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::All);
 	ProcessingPhase = EMassProcessingPhase::FrameEnd;
 	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Tasks;
+	DemandStream.GenerateNewSeed();
 }
 
 void URoguePassengerSpawnProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
 {
-	EntityQuery.AddRequirement<FRogueStationQueueFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FRogueStationFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FRogueStationQueueFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddTagRequirement<FRogueTrainStationTag>(EMassFragmentPresence::All);
 	EntityQuery.RegisterWithProcessor(*this);
 }
@@ -33,46 +38,131 @@ void URoguePassengerSpawnProcessor::Execute(FMassEntityManager& EntityManager, F
 	const FRogueTrackSharedFragment& TrackSharedFragment = TrainSubsystem->GetTrackShared();
 	if (!TrackSharedFragment.IsValid()) return;
 	
+	const auto* RouteSubsystem = Context.GetWorld()->GetSubsystem<URogueRouteSubsystem>();
+	const bool bRouted = RouteSubsystem && RouteSubsystem->HasRoutes();
+	
 	const FMassEntityTemplate* PassengerEntityTemplate = TrainSubsystem->GetPassengerTemplate();
-	if (!PassengerEntityTemplate->IsValid()) return;
+	if (!PassengerEntityTemplate || !PassengerEntityTemplate->IsValid()) return;
 	
 	SpawnAccumulator += Context.GetDeltaTimeSeconds();
 	if (SpawnAccumulator < Settings->SpawnIntervalSeconds) return;
+	const float Elapsed = SpawnAccumulator;
 	SpawnAccumulator = 0.f;
 
-	// Cap overall passengers
-	if (TrainSubsystem->GetLiveCount(ERogueEntityType::Passenger) >= Settings->MaxPassengersOverall) return;
+	// Cap overall passengers, queued spawns and virtual riders included
+	const int32 Headroom = Settings->MaxPassengersOverall
+		- TrainSubsystem->GetLiveCount(ERogueEntityType::Passenger)
+		- TrainSubsystem->GetVirtualRiderCount()
+		- TrainSubsystem->GetPendingSpawnCount(ERogueEntityType::Passenger);
+	if (Headroom <= 0) return;
+
+	const int32 NumStations = TrackSharedFragment.StationEntities.Num();
+	const URogueDemandAsset* DemandAsset = TrainSubsystem->GetPassengerDemand();
+	if (NumStations != DemandStations) BuildDemandTables(*Settings, DemandAsset, TrackSharedFragment);
+
+	// Poisson arrivals for every station over the elapsed interval, scaled by the time of day
+	const float TimeScale = DemandAsset ? DemandAsset->GetTimeOfDayScale(static_cast<float>(Context.GetWorld()->GetTimeSeconds())) : 1.f;
+	RogueDemandUtility::SampleArrivals(DemandStream, OriginRates, TimeScale, Elapsed, Arrivals);
+
+	// Arrivals over the cap are dropped rather than queued up, every station keeps its share of the headroom
+	if (NumStations > 0)
+	{
+		RogueDemandUtility::ShareHeadroom(Arrivals, Headroom, HeadroomCursor);
+		HeadroomCursor = (HeadroomCursor + 1) % NumStations;
+	}
+
+	// One batched request per station
+	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
+	{
+		const TConstArrayView<FRogueStationFragment> StationFragments = SubContext.GetFragmentView<FRogueStationFragment>();
+		const TConstArrayView<FRogueStationQueueFragment> StationQueueFragments = SubContext.GetFragmentView<FRogueStationQueueFragment>();
+
+		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
+		{
+			const int32 StationIndex = StationFragments[i].StationIndex;
+			const FRogueStationQueueFragment& StationQueueFragment = StationQueueFragments[i];
+			if (!Arrivals.IsValidIndex(StationIndex) || StationQueueFragment.SpawnPoints.Num() == 0) continue;
+
+			const int32 Count = Arrivals[StationIndex];
+			if (Count <= 0) continue;
+
+			const TConstArrayView<float> DestinationRow(DestinationCdf.GetData() + StationIndex * NumStations, NumStations);
+
+			FRogueSpawnRequest Request;
+			Request.Type = ERogueEntityType::Passenger;
+			Request.EntityTemplate = PassengerEntityTemplate;
+			Request.OriginStation = SubContext.GetEntity(i);
+			Request.AcceptanceRadius = Settings->PassengerAcceptanceRadius;
+			Request.MaxSpeed = Settings->PassengerMaxSpeed;
+			Request.PassengerPayloads.Reserve(Count);
 
-	// Pick a random station that has spawn points to spawn at
-	const FMassEntityHandle StationHandle = TrackSharedFragment.GetRandomStationEntity();
-	if (!StationHandle.IsValid()) return;
+			for (int32 k = 0; k < Count; ++k)
+			{
+				// Random spawn point, destination drawn from the origin row. An empty row has nowhere to go, skip the arrival
+				const FVector Location = StationQueueFragment.SpawnPoints[DemandStream.RandHelper(StationQueueFragment.SpawnPoints.Num())];
+				const int32 DestinationIndex = RogueDemandUtility::SampleCdf(DemandStream, DestinationRow);
+				if (DestinationIndex == INDEX_NONE) continue;
 
-	// Get station queue fragment from chosen station
-	auto* StationQueueFragment = EntityManager.GetFragmentDataPtr<FRogueStationQueueFragment>(StationHandle);
-	if (!StationQueueFragment || StationQueueFragment->SpawnPoints.Num() == 0) return;
+				FRoguePassengerSpawnPayload& Payload = Request.PassengerPayloads.AddDefaulted_GetRef();
+				Payload.Location = Location;
+				Payload.DestinationStation = TrackSharedFragment.GetStationEntityByIndex(DestinationIndex);
+				Payload.RouteIndex = INDEX_NONE;
+				// Only draw when priority boarding is on, so seeded demand sequences are unchanged without it
+				Payload.BoardingPriority = (Settings->PriorityPassengerChance > 0.f && DemandStream.GetFraction() < Settings->PriorityPassengerChance) ? 1 : 0;
 
-	// Get a random station index for destination that is not current station index
-	const FMassEntityHandle DestinationStation = TrackSharedFragment.GetRandomStationEntity();
-	if (!DestinationStation.IsValid()) return;
+				// Across lines the first leg ends at an interchange, the passenger keeps the final station as its route
+				const int32 FirstHop = bRouted ? RouteSubsystem->GetNextHop(StationIndex, DestinationIndex) : INDEX_NONE;
+				if (FirstHop != INDEX_NONE)
+				{
+					Payload.DestinationStation = TrackSharedFragment.GetStationEntityByIndex(FirstHop);
+					Payload.RouteIndex = DestinationIndex;
+				}
+			}
+
+			if (Request.PassengerPayloads.Num() == 0) continue;
+
+			Request.RemainingCount = Request.PassengerPayloads.Num();
+			TrainSubsystem->EnqueueSpawns(MoveTemp(Request));
+		}
+	});
+}
+
+void URoguePassengerSpawnProcessor::BuildDemandTables(const URogueDeveloperSettings& Settings, const URogueDemandAsset* DemandAsset, const FRogueTrackSharedFragment& Track)
+{
+	const int32 NumStations = Track.StationEntities.Num();
+	DemandStations = NumStations;
+	Arrivals.Init(0, NumStations);
+
+	// Tables are by station index (track order), settings are looked up through the entry each platform was built from
+	StationConfigIndices.Init(INDEX_NONE, NumStations);
+	for (int32 i = 0; i < NumStations && Track.Platforms.IsValidIndex(i); ++i)
+	{
+		StationConfigIndices[i] = Track.Platforms[i].ConfigIndex;
+	}
 	
-	// Choose a random waiting point
-	const int32 WaitingIdx = (StationQueueFragment->WaitingPoints.Num() > 0)
-		? FMath::RandRange(0, StationQueueFragment->WaitingPoints.Num() - 1)
-		: INDEX_NONE;
-
-	// Choose a random spawn point
-	const FVector SpawnLoc = StationQueueFragment->SpawnPoints[FMath::RandHelper(StationQueueFragment->SpawnPoints.Num())];
-
-	FRogueSpawnRequest Request;
-	Request.Type = ERogueEntityType::Passenger;
-	Request.EntityTemplate = PassengerEntityTemplate;
-	Request.RemainingCount = 1;
-	Request.Transform = FTransform(SpawnLoc);
-	Request.OriginStation = StationHandle;
-	Request.DestinationStation = DestinationStation;
-	Request.WaitingPointIdx = WaitingIdx;
-	Request.AcceptanceRadius = Settings->PassengerAcceptanceRadius;
-	Request.MaxSpeed = Settings->PassengerMaxSpeed;
-
-	TrainSubsystem->EnqueueSpawns(Request);
+	// Loaded by the train subsystem with the entity configs, never mid-frame here
+	if (DemandAsset)
+	{
+		DemandAsset->BuildTables(StationConfigIndices, OriginRates, DestinationCdf);
+		return;
+	}
+
+	// No matrix, per station rates with a uniform destination other than the origin
+	OriginRates.Init(0.f, NumStations);
+	DestinationCdf.Init(0.f, NumStations * NumStations);
+	for (int32 Origin = 0; Origin < NumStations; ++Origin)
+	{
+		const int32 ConfigIdx = StationConfigIndices[Origin];
+		const float StationRate = Settings.Stations.IsValidIndex(ConfigIdx) ? Settings.Stations[ConfigIdx].PassengerDemandRate : -1.f;
+		OriginRates[Origin] = (StationRate >= 0.f) ? StationRate : Settings.PassengerDemandRate;
+
+		float* Cdf = DestinationCdf.GetData() + Origin * NumStations;
+		const float Step = (NumStations > 1) ? 1.f / (NumStations - 1) : 0.f;
+		float Total = 0.f;
+		for (int32 Destination = 0; Destination < NumStations; ++Destination)
+		{
+			if (Destination != Origin) Total += Step;
+			Cdf[Destination] = Total;
+		}
+	}
 }
@@ -50,24 +50,25 @@ void URogueTrainStationDetectProcessor::Execute(FMassEntityManager& EntityManage
 
 			if (State.TargetStationIdx == INDEX_NONE)
 			{
-				State.TargetStationIdx = RogueTrainUtility::FindNextStation(*TrackSharedFragment.Spline, TrackSharedFragment.Platforms, TrackFollowFragment.Alpha);
-				State.PrevAlpha = TrackFollowFragment.Alpha;
+				State.TargetStationIdx = RogueTrainUtility::FindNextStation(TrackSharedFragment, TrackFollowFragment.Distance);
+				State.PrevDistance = TrackFollowFragment.Distance;
 				continue; // next tick we’ll evaluate distance
 			}
 
-			const float DockAlpha = TrackSharedFragment.Platforms[State.TargetStationIdx].DockAlpha;
-			const float PrevDistAlpha = RogueTrainUtility::ArcDistanceWrapped(State.PrevAlpha, DockAlpha);
-			const float DistAlpha = RogueTrainUtility::ArcDistanceWrapped(TrackFollowFragment.Alpha, DockAlpha);
-			const float Dist = DistAlpha * TrackSharedFragment.TrackLength;
+			// Distances in cm (double), alpha * length loses the arrival radius on long lines
+			const double TrackLength = TrackSharedFragment.TrackLength;
+			const double DockDistance = TrackSharedFragment.Platforms[State.TargetStationIdx].DockDistance;
+			const double PrevDist = RogueTrainUtility::ForwardDistanceWrapped(State.PrevDistance, DockDistance, TrackLength);
+			const double Dist = RogueTrainUtility::ForwardDistanceWrapped(TrackFollowFragment.Distance, DockDistance, TrackLength);
 			const float DeltaTime = SubContext.GetDeltaTimeSeconds();
 
-			if (DistAlpha > PrevDistAlpha && !State.bAtStation)
+			if (Dist > PrevDist && !State.bAtStation)
 			{
 				// missed the stop; advance target and reset stopping flags
 				State.bIsStopping = false;
 				State.bAtStation = false;
 				State.PreviousStationIdx = State.TargetStationIdx;
-				State.TargetStationIdx = RogueTrainUtility::FindNextStation(*TrackSharedFragment.Spline, TrackSharedFragment.Platforms, TrackFollowFragment.Alpha);
+				State.TargetStationIdx = RogueTrainUtility::FindNextStation(TrackSharedFragment, TrackFollowFragment.Distance);
 			}
 			
 			if (!State.bAtStation)
@@ -106,7 +107,7 @@ void URogueTrainStationDetectProcessor::Execute(FMassEntityManager& EntityManage
 				}
 			}
 			
-			State.PrevAlpha = TrackFollowFragment.Alpha;
+			State.PrevDistance = TrackFollowFragment.Distance;
 		}
 	});	
 }
@@ -55,8 +55,11 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 
 			switch (State.StationTrainPhase)
 			{
-				case ERogueStationTrainPhase::NotStopped: State.StationTrainPhase = ERogueStationTrainPhase::Arriving;
-					break;
+				case ERogueStationTrainPhase::NotStopped:
+				{
+					State.StationTrainPhase = ERogueStationTrainPhase::Arriving;
+				}
+				break;
 				case ERogueStationTrainPhase::Arriving:
 				{
 					// Unload passengers on first half of dwell time
@@ -81,6 +84,15 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 					if (State.StationTimeRemaining < DepartureTime)
 					{
 						State.StationTrainPhase = ERogueStationTrainPhase::Departing;
+
+						// Boarding orders belong to this station, the next one builds its own
+						for (const FMassEntityHandle CarriageEntity : State.Carriages)
+						{
+							if (auto* CarriageFragment = EntityManager.GetFragmentDataPtr<FRogueCarriageFragment>(CarriageEntity))
+							{
+								CarriageFragment->WaitingPointOrder.Reset();
+							}
+						}
 					}
 				}
 				break;
@@ -113,47 +125,26 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 					auto* CarriageFragment = EntityManager.GetFragmentDataPtr<FRogueCarriageFragment>(CarriageEntity);
 					if (!CarriageFragment) continue;
 
-					if (CarriageFragment->Occupants.Num() <= 0) EmptyCarriages++;
+					if (CarriageFragment->GetNumRiders() <= 0) EmptyCarriages++;
 					if (CurrentTime < CarriageFragment->NextAllowedUnloadTime) continue;
 
 					auto* CarriageTransformFragment = EntityManager.GetFragmentDataPtr<FTransformFragment>(CarriageEntity);
 					if (!CarriageTransformFragment) continue;
 
 					const FVector CarriageLocation = CarriageTransformFragment->GetTransform().GetLocation();
+
+					// Virtual riders for this station are respawned first, at the same unload rate as entity riders
+					if (RoguePassengerUtility::MaterializeRider(*TrainSubsystem, *CarriageFragment, CurrentStationEntity, CarriageLocation))
+					{
+						CarriageFragment->NextAllowedUnloadTime = CurrentTime + Settings->UnloadIntervalSeconds;
+						continue;
+					}
 					
-					const int32 NumOccupants = CarriageFragment->Occupants.Num();
-					for (int32 Attempts = 0; Attempts < NumOccupants; ++Attempts)
+					// Only disembark riders bucketed for this station
+					if (RoguePassengerUtility::Disembark(EntityManager, SubContext, *CarriageFragment, CurrentStationEntity, CarriageLocation))
 					{
-						const int32 Idx = CarriageFragment->UnloadCursor % CarriageFragment->Occupants.Num();
-						const FMassEntityHandle Passenger = CarriageFragment->Occupants[Idx];
-
-						if (!RoguePassengerUtility::IsHandleValid(EntityManager, Passenger))
-						{
-							CarriageFragment->Occupants.RemoveAtSwap(Idx);
-							continue;
-						}
-
-						const FRoguePassengerFragment* PassengerFragment = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger);
-						if (!PassengerFragment)
-						{
-							CarriageFragment->Occupants.RemoveAtSwap(Idx);
-							continue;
-						}
-
-						// Only disembark if this is the destination station
-						if (PassengerFragment->DestinationStation == CurrentStationEntity)
-						{
-							RoguePassengerUtility::Disembark(EntityManager, SubContext, *CarriageFragment, Idx, CarriageLocation);
-							CarriageFragment->NextAllowedUnloadTime = CurrentTime + Settings->UnloadIntervalSeconds;
-							
-							// Keeping UnloadCursor at same Idx; the next passenger shifts into this slot
-							break;
-						}
-
-						// Advance cursor if this passenger is not for this station
-						++CarriageFragment->UnloadCursor;
+						CarriageFragment->NextAllowedUnloadTime = CurrentTime + Settings->UnloadIntervalSeconds;
 					}
-										
 				}
 
 				if (EmptyCarriages >= CarriageList.Num())
@@ -169,31 +160,23 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 				for (const FMassEntityHandle CarriageEntity : CarriageList)
 				{
 					auto* CarriageFragment = EntityManager.GetFragmentDataPtr<FRogueCarriageFragment>(CarriageEntity);
-					const FTransformFragment* CarriageTransformFragment = EntityManager.GetFragmentDataPtr<FTransformFragment>(CarriageEntity);
-					if (!CarriageFragment || !CarriageTransformFragment) continue;
+					if (!CarriageFragment) continue;
 
-					const int32 FreeSlots = CarriageFragment->Capacity - CarriageFragment->Occupants.Num();
+					const int32 FreeSlots = CarriageFragment->Capacity - CarriageFragment->GetNumRiders();
 					if (FreeSlots <= 0) continue;
 
 					int32 BoardingBudget = FMath::Min(FreeSlots, MaxLoadPerTickPerCar);
 					if (BoardingBudget <= 0) continue;
 
-					// Build a list of WP indices from the TMap
-					TArray<int32> WaitingPointIndices;
-					WaitingPointIndices.Reserve(StationQueueFragment->Grids.Num());
-					for (const auto& Pair : StationQueueFragment->Grids)
+					// Waiting points nearest first, worked out once per dwell. Carriages that joined after the train docked get theirs here too
+					if (CarriageFragment->WaitingPointOrder.IsEmpty())
 					{
-						WaitingPointIndices.Add(Pair.Key);
+						const FTransformFragment* CarriageTransformFragment = EntityManager.GetFragmentDataPtr<FTransformFragment>(CarriageEntity);
+						if (!CarriageTransformFragment) continue;
+						
+						BuildWaitingPointOrder(*StationQueueFragment, CarriageTransformFragment->GetTransform().GetLocation(), CarriageFragment->WaitingPointOrder);
 					}
-
-					// Sort by distance to carriage
-					const FVector CarriageLocation = CarriageTransformFragment->GetTransform().GetLocation();
-					WaitingPointIndices.Sort([&](const int32 A, const int32 B)
-					{
-						const FVector& PositionA = StationQueueFragment->WaitingPoints[A];
-						const FVector& PositionB = StationQueueFragment->WaitingPoints[B];
-						return FVector::DistSquared(PositionA, CarriageLocation) < FVector::DistSquared(PositionB, CarriageLocation);
-					});
+					const TArray<int32>& WaitingPointIndices = CarriageFragment->WaitingPointOrder;
 
 					// Drain queues in waiting point distance order
 					for (int32 j = 0; j < WaitingPointIndices.Num() && BoardingBudget > 0; ++j)
@@ -207,17 +190,21 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 							FVector SlotPos;
 
 							// Peek at next passenger in queue, if none move to next waiting point
-							if (!RogueStationQueueUtility::PeekFromGrid(EntityManager, *StationQueueFragment, WaitingPointIdx, Passenger, CurrentStationEntity, SlotIdx, SlotPos))
+							if (!RogueStationQueueUtility::PeekFromGrid(*StationQueueFragment, WaitingPointIdx, Passenger, SlotIdx, SlotPos))
 								break;
+
+							// Entity gone while waiting, free the slot so it doesn't hold up the queue
+							if (!RoguePassengerUtility::IsHandleValid(EntityManager, Passenger))
+							{
+								RogueStationQueueUtility::ReleaseWaitingSlot(*StationQueueFragment, WaitingPointIdx, SlotIdx);
+								continue;
+							}
 							
 							// Try to board passenger, if successful remove from queue, if unsuccessful break to next waiting point as carriage is likely full
 							if (RoguePassengerUtility::TryBoard(EntityManager, SubContext, Passenger, CarriageEntity, *CarriageFragment))
 							{
-								// Successfully boarded — release the slot
-								if (const FRoguePassengerFragment* PassengerFragment = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger))
-								{
-									RogueStationQueueUtility::ReleaseSlot(*StationQueueFragment, *PassengerFragment);
-								}
+								// Successfully boarded — release the slot, pops it from the boarding queue
+								RogueStationQueueUtility::ReleaseWaitingSlot(*StationQueueFragment, WaitingPointIdx, SlotIdx);
 					
 								// Clear passenger’s waiting data
 								if (FRoguePassengerFragment* PassengerFragmentMutable = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger))
@@ -225,6 +212,7 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
 									PassengerFragmentMutable->WaitingPointIdx = INDEX_NONE;
 									PassengerFragmentMutable->WaitingSlotIdx = INDEX_NONE;
 									PassengerFragmentMutable->bWaiting = false;
+									SubContext.Defer().PushCommand<FMassCommandRemoveTag<FRoguePassengerQueuedTag>>(Passenger);
 								}
 								--BoardingBudget;
 							}
@@ -240,3 +228,24 @@ void URogueTrainStationOpsProcessor::Execute(FMassEntityManager& EntityManager,
         }
     });
 }
+
+void URogueTrainStationOpsProcessor::BuildWaitingPointOrder(const FRogueStationQueueFragment& StationQueueFragment, const FVector& CarriageLocation,
+	TArray<int32>& Order)
+{
+	const int32 NumWaitingPoints = FMath::Min(StationQueueFragment.Grids.Num(), StationQueueFragment.WaitingPoints.Num());
+
+	// Reset keeps the allocation from the previous station
+	Order.Reset();
+	for (int32 WaitingPointIdx = 0; WaitingPointIdx < NumWaitingPoints; ++WaitingPointIdx)
+	{
+		Order.Add(WaitingPointIdx);
+	}
+
+	// Sort by distance to the docked carriage
+	Order.Sort([&](const int32 A, const int32 B)
+	{
+		const FVector& PositionA = StationQueueFragment.WaitingPoints[A];
+		const FVector& PositionB = StationQueueFragment.WaitingPoints[B];
+		return FVector::DistSquared(PositionA, CarriageLocation) < FVector::DistSquared(PositionB, CarriageLocation);
+	});
+}
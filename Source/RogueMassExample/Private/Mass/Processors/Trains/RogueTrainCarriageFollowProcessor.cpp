@@ -5,7 +5,6 @@
 
 #include "MassCommonFragments.h"
 #include "MassCommonTypes.h"
-#include "MassEntityView.h"
 #include "MassExecutionContext.h"
 #include "Data/RogueDeveloperSettings.h"
 #include "Mass/Processors/Trains/RogueTrainEngineMovementProcessor.h"
@@ -26,6 +25,8 @@ void URogueTrainCarriageFollowProcessor::ConfigureQueries(const TSharedRef<FMass
 	EntityQuery.AddRequirement<FRogueTrainLinkFragment>(EMassFragmentAccess::ReadOnly);
 	EntityQuery.AddTagRequirement<FRogueTrainCarriageTag>(EMassFragmentPresence::All);
 	EntityQuery.RegisterWithProcessor(*this);
+
+	ProcessorRequirements.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadOnly);
 }
 
 void URogueTrainCarriageFollowProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
@@ -39,39 +40,45 @@ void URogueTrainCarriageFollowProcessor::Execute(FMassEntityManager& EntityManag
 	const auto* Settings = GetDefault<URogueDeveloperSettings>();
 	const float RideHeight = Settings ? Settings->CarriageRideHeight : 0.f;
 
+	const double TrackLength = TrackSharedFragment.TrackLength;
+	const TConstArrayView<double> HeadDistances = TrainSubsystem->GetTrainHeadDistances();
+	RogueTrainUtility::FTrackBatch Batch;
+
 	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
 	{
 		const auto FollowView = SubContext.GetMutableFragmentView<FRogueTrainTrackFollowFragment>();
 		const auto LinkView = SubContext.GetFragmentView<FRogueTrainLinkFragment>();
 		const auto TransformView = SubContext.GetMutableFragmentView<FTransformFragment>();
+		const int32 NumEntities = SubContext.GetNumEntities();
 
-		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
+		// Resolve each carriage distance behind its train head, then sample the whole chunk at once
+		Batch.Reset(NumEntities);
+		for (int32 i = 0; i < NumEntities; ++i)
 		{
 			const auto& Link = LinkView[i];
-			if (!Link.LeadHandle.IsSet() || !EntityManager.IsEntityValid(Link.LeadHandle))
-				continue;
-	
-			const FRogueTrainTrackFollowFragment* LeadFollow = EntityManager.GetFragmentDataPtr<FRogueTrainTrackFollowFragment>(Link.LeadHandle);
-			if (!LeadFollow) continue;
+			if (!HeadDistances.IsValidIndex(Link.TrainIndex)) continue;
 			
 			// Center-to-center spacing in **cm** (prefer per-car value; else fall back to settings)
 			const float Spacing = (Link.Spacing > 0.f) ? Link.Spacing : (Settings ? Settings->CarriageLength + Settings->CarriageSpacing : 0.f);
-
-			RogueTrainUtility::FSplineStationSample SplineSample;
 			const float OffsetDist = FMath::Max(1, Link.CarriageIndex) * Spacing;
-			if (!RogueTrainUtility::GetSplineSample(TrackSharedFragment, LeadFollow->Alpha, -OffsetDist, 0.f, RideHeight, SplineSample))
-				continue;			
+
+			Batch.Add(i, RogueTrainUtility::WrapTrackDistance(HeadDistances[Link.TrainIndex] - OffsetDist, TrackLength));
+		}
+
+		if (Batch.Num() == 0 || !RogueTrainUtility::SampleTrackBatch(TrackSharedFragment, RideHeight, Batch)) return;
+
+		for (int32 b = 0; b < Batch.Num(); ++b)
+		{
+			const int32 i = Batch.EntityIndices[b];
 
 			// Update carriage follow state
 			auto& Follow = FollowView[i];
-			Follow.Alpha = SplineSample.Alpha;
-			Follow.WorldPos = SplineSample.Location;
-			Follow.WorldFwd = SplineSample.Forward;
-			
-			FTransform& TrainTransform = TransformView[i].GetMutableTransform();
-			TrainTransform = SplineSample.World;
-			const FQuat Rot = FRotationMatrix::MakeFromXZ(SplineSample.Forward, FVector::UpVector).ToQuat();
-			TrainTransform.SetRotation(Rot);
+			Follow.Distance = Batch.Distances[b];
+			Follow.Alpha = static_cast<float>(Batch.Distances[b] / TrackLength);
+			Follow.WorldPos = Batch.Locations[b];
+			Follow.WorldFwd = Batch.Forwards[b];
+
+			TransformView[i].GetMutableTransform() = FTransform(Batch.Rotations[b], Batch.Locations[b], FVector::OneVector);
 		}
 	});
 }
\ No newline at end of file
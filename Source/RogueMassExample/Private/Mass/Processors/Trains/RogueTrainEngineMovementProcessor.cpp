@@ -24,6 +24,8 @@ void URogueTrainEngineMovementProcessor::ConfigureQueries(const TSharedRef<FMass
 	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite, EMassFragmentPresence::All);
 	EntityQuery.AddTagRequirement<FRogueTrainEngineTag>(EMassFragmentPresence::All);
 	EntityQuery.RegisterWithProcessor(*this);	
+
+	ProcessorRequirements.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadWrite);
 }
 
 void URogueTrainEngineMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
@@ -38,6 +40,10 @@ void URogueTrainEngineMovementProcessor::Execute(FMassEntityManager& EntityManag
 	if (!Settings) return;
 	const float RideHeight = Settings ? Settings->CarriageRideHeight : 0.f;
 
+	const double TrackLength = TrackSharedFragment.TrackLength;
+	const TArrayView<double> HeadDistances = TrainSubsystem->GetMutableTrainHeadDistances();
+	RogueTrainUtility::FTrackBatch Batch;
+
 	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
 	{
 		const auto TrackFollowFragments = SubContext.GetMutableFragmentView<FRogueTrainTrackFollowFragment>();
@@ -45,12 +51,12 @@ void URogueTrainEngineMovementProcessor::Execute(FMassEntityManager& EntityManag
 		const auto TransformView = SubContext.GetMutableFragmentView<FTransformFragment>();
 		const int32 NumEntities = SubContext.GetNumEntities();
 
+		// Advance speeds and alphas, queue the new distances for one batched track sample
+		Batch.Reset(NumEntities);
 		for (int32 i = 0; i < NumEntities; ++i)
 		{
-			const FMassEntityHandle Entity = SubContext.GetEntity(i);
 			auto& TrackFollowFragment = TrackFollowFragments[i];
 			const auto& State  = StateView[i];
-			FTransform& TrainTransform = TransformView[i].GetMutableTransform();
 			if (!TrackSharedFragment.StationEntities.IsValidIndex(State.TargetStationIdx)) continue;
 
 			float TargetSpeed = Settings->LeadCruiseSpeed;
@@ -65,21 +71,41 @@ void URogueTrainEngineMovementProcessor::Execute(FMassEntityManager& EntityManag
 				TargetSpeed = FMath::Min(TargetSpeed, Settings->StationApproachSpeed);
 			}
 
-			// Use 'target' for your acceleration model
-			TrackFollowFragment.Speed = FMath::FInterpTo(TrackFollowFragment.Speed, TargetSpeed, SubContext.GetDeltaTimeSeconds(), 2.f);
-			TrackFollowFragment.Alpha = RogueTrainUtility::WrapTrackAlpha(TrackFollowFragment.Alpha + (TrackFollowFragment.Speed * SubContext.GetDeltaTimeSeconds()) / TrackSharedFragment.TrackLength );
-
-			RogueTrainUtility::FSplineStationSample SplineSample;
-			if (!RogueTrainUtility::GetSplineSample(TrackSharedFragment, TrackFollowFragment.Alpha, 0, 0.f, RideHeight, SplineSample))
-				continue;
-
-			TrackFollowFragment.Alpha = SplineSample.Alpha;
-			TrackFollowFragment.WorldPos = SplineSample.Location;
-			TrackFollowFragment.WorldFwd = SplineSample.Forward;
-			
-			TrainTransform = SplineSample.World;
-			const FQuat Rot = FRotationMatrix::MakeFromXZ(SplineSample.Forward, FVector::UpVector).ToQuat();
-			TrainTransform.SetRotation(Rot);
+			// The signal pass limit is a target too, a train can always stop inside the blocks it holds
+			TargetSpeed = FMath::Min(TargetSpeed, State.SignalSpeedLimit);
+
+			// Over the signal limit brake at the rate it was worked out with, otherwise ease towards the target
+			if (TrackFollowFragment.Speed > State.SignalSpeedLimit)
+			{
+				TrackFollowFragment.Speed = FMath::FInterpConstantTo(TrackFollowFragment.Speed, TargetSpeed, SubContext.GetDeltaTimeSeconds(), Settings->BrakingDeceleration);
+			}
+			else
+			{
+				TrackFollowFragment.Speed = FMath::FInterpTo(TrackFollowFragment.Speed, TargetSpeed, SubContext.GetDeltaTimeSeconds(), 2.f);
+			}
+			TrackFollowFragment.Distance = RogueTrainUtility::WrapTrackDistance(TrackFollowFragment.Distance + TrackFollowFragment.Speed * SubContext.GetDeltaTimeSeconds(), TrackLength);
+			TrackFollowFragment.Alpha = static_cast<float>(TrackFollowFragment.Distance / TrackLength);
+
+			const double HeadDistance = TrackFollowFragment.Distance;
+			if (HeadDistances.IsValidIndex(State.TrainIndex))
+			{
+				// Published for the carriage pass, which reads it by train index instead of resolving the lead
+				HeadDistances[State.TrainIndex] = HeadDistance;
+			}
+
+			Batch.Add(i, HeadDistance);
+		}
+
+		if (Batch.Num() == 0 || !RogueTrainUtility::SampleTrackBatch(TrackSharedFragment, RideHeight, Batch)) return;
+
+		for (int32 b = 0; b < Batch.Num(); ++b)
+		{
+			const int32 i = Batch.EntityIndices[b];
+			auto& TrackFollowFragment = TrackFollowFragments[i];
+			TrackFollowFragment.WorldPos = Batch.Locations[b];
+			TrackFollowFragment.WorldFwd = Batch.Forwards[b];
+
+			TransformView[i].GetMutableTransform() = FTransform(Batch.Rotations[b], Batch.Locations[b], FVector::OneVector);
 		}
 	});
 }
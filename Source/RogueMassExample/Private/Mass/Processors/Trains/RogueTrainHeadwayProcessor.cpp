@@ -21,6 +21,8 @@ void URogueTrainHeadwayProcessor::ConfigureQueries(const TSharedRef<FMassEntityM
 	EntityQuery.AddRequirement<FRogueTrainStateFragment>(EMassFragmentAccess::ReadWrite);
 	EntityQuery.AddTagRequirement<FRogueTrainEngineTag>(EMassFragmentPresence::All);
 	EntityQuery.RegisterWithProcessor(*this);
+
+	ProcessorRequirements.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadWrite);
 }
 
 void URogueTrainHeadwayProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
@@ -34,16 +36,16 @@ void URogueTrainHeadwayProcessor::Execute(FMassEntityManager& EntityManager, FMa
 	const auto* Settings = GetDefault<URogueDeveloperSettings>();
 	if (!Settings) return;
 
-	const float TrackLength = TrackSharedFragment.TrackLength;	
+	const double TrackLength = TrackSharedFragment.TrackLength;	
 	const float EngineLength = Settings ? Settings->EngineLength : 1200.f;
 	const float CarriageLength = Settings ? Settings->CarriageLength : 1000.f; 
-	const float Spacing = (Settings ? Settings->CarriageSpacing : 8.f);	
 
-	if(TrackLength <= 0.f) return;
+	if(TrackLength <= 0.0) return;
 
-	struct FEntry { FMassEntityHandle EntityHandle; float LeadAlpha; float TailAlpha; };
-	TArray<FEntry> Engines; Engines.Reserve(64);
+	const TArrayView<double> HeadDistances = TrainSubsystem->GetMutableTrainHeadDistances();
+	const TArrayView<float> TrainLengths = TrainSubsystem->GetMutableTrainLengths();
 
+	// Publish head distance and length per train
 	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
 	{
 		const TConstArrayView<FRogueTrainTrackFollowFragment> FollowView = SubContext.GetFragmentView<FRogueTrainTrackFollowFragment>();
@@ -51,14 +53,11 @@ void URogueTrainHeadwayProcessor::Execute(FMassEntityManager& EntityManager, FMa
 
 		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
 		{
-			const auto& Follow = FollowView[i];
 			auto& State = StateView[i];
 
 			// Clear headway
 			State.HeadwaySpeedScale = 1.f;
 
-			const float LeadAlpha = Follow.Alpha;
-
 			// per-lead carriages if you track it, else default
 			int32 NumCars = Settings ? Settings->CarriagesPerTrain : 3;
 			if (State.Carriages.Num() > 0)
@@ -67,16 +66,16 @@ void URogueTrainHeadwayProcessor::Execute(FMassEntityManager& EntityManager, FMa
 			}
 			
 			State.TrainLength = EngineLength + NumCars * CarriageLength;
-			const float DeltaTime = State.TrainLength / TrackLength;
-			const float TailAlpha = RogueTrainUtility::WrapTrackAlpha(LeadAlpha - DeltaTime);
 
-			Engines.Add({ SubContext.GetEntity(i), LeadAlpha, TailAlpha });
+			if (!HeadDistances.IsValidIndex(State.TrainIndex)) continue;
+			HeadDistances[State.TrainIndex] = FollowView[i].Distance;
+			TrainLengths[State.TrainIndex] = State.TrainLength;
 		}
 	});
 
-	if (Engines.Num() <= 1) return;
-
-	Algo::SortBy(Engines, &FEntry::LeadAlpha);		
+	TrainSubsystem->RepairTrainOrder();
+	const TConstArrayView<int32> Order = TrainSubsystem->GetTrainOrder();
+	if (Order.Num() <= 1) return;
 
 	auto GapToScale = [&](const float Gap, const float TrainLength)
 	{
@@ -87,42 +86,28 @@ void URogueTrainHeadwayProcessor::Execute(FMassEntityManager& EntityManager, FMa
 		return FMath::Pow(t, 1.5f); //(ease in)
 	};
 
-	// Check gap to next engine's tail
-	for (int32 Idx = 0; Idx < Engines.Num(); ++Idx)
+	// Walk the ring, checking the gap from each head to the next train's tail
+	HeadwayScales.SetNumUninitialized(HeadDistances.Num());
+	for (int32 Idx = 0; Idx < Order.Num(); ++Idx)
 	{
-		const FEntry& Current = Engines[Idx];
-		const FEntry& Next = Engines[(Idx+1) % Engines.Num()];
+		const int32 Current = Order[Idx];
+		const int32 Next = Order[(Idx + 1) % Order.Num()];
+
+		const double Gap = RogueTrainUtility::ForwardDistanceWrapped(HeadDistances[Current], HeadDistances[Next] - TrainLengths[Next], TrackLength);
 
-		// Distance forward along track from current.lead to next.tail
-		const float ArcDist = RogueTrainUtility::ArcDistanceWrapped(Current.LeadAlpha, Next.TailAlpha);
-		const float Gap = ArcDist * TrackLength;
+		HeadwayScales[Current] = GapToScale(static_cast<float>(Gap), TrainLengths[Current]);
+	}
+
+	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
+	{
+		const TArrayView<FRogueTrainStateFragment> StateView = SubContext.GetMutableFragmentView<FRogueTrainStateFragment>();	
 
-		if (auto* State = EntityManager.GetFragmentDataPtr<FRogueTrainStateFragment>(Current.EntityHandle))
+		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
 		{
-			const float Scale = GapToScale(Gap, State->TrainLength);
-			
-			if (const FRogueTrainTrackFollowFragment* Follow = EntityManager.GetFragmentDataPtr<FRogueTrainTrackFollowFragment>(Current.EntityHandle))
-			{
-				int32 TargetIdx = State->TargetStationIdx;
-				if (TargetIdx == INDEX_NONE)
-				{
-					// If you no longer store alphas, call your “next station” helper here
-					TargetIdx = RogueTrainUtility::FindNextStation(*TrackSharedFragment.Spline, TrackSharedFragment.Platforms, Follow->Alpha);
-				}
-
-				if (TargetIdx != INDEX_NONE)
-				{
-					const float StationAlpha = TrackSharedFragment.GetStationAlphaByIndex(TargetIdx);
-					const float DistToStation = RogueTrainUtility::ArcDistanceWrapped(Follow->Alpha, StationAlpha) * TrackLength;
-
-					if (DistToStation <= Gap || State->bIsStopping || State->bAtStation)
-					{
-						State->HeadwaySpeedScale = 1.f; // station logic wins
-					}
-				}
-			}
+			auto& State = StateView[i];
+			if (!HeadwayScales.IsValidIndex(State.TrainIndex)) continue;
 			
-			State->HeadwaySpeedScale = FMath::Min(State->HeadwaySpeedScale, Scale);
+			State.HeadwaySpeedScale = FMath::Min(State.HeadwaySpeedScale, HeadwayScales[State.TrainIndex]);
 		}
-	}
+	});
 }
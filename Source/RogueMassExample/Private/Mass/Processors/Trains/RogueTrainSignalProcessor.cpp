@@ -0,0 +1,113 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Mass/Processors/Trains/RogueTrainSignalProcessor.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "Data/RogueDeveloperSettings.h"
+#include "Mass/Fragments/RogueFragments.h"
+#include "Mass/Processors/Trains/RogueTrainEngineMovementProcessor.h"
+#include "Mass/Processors/Trains/RogueTrainHeadwayProcessor.h"
+#include "Subsystems/RogueTrainWorldSubsystem.h"
+#include "Utilities/RogueTrainUtility.h"
+
+URogueTrainSignalProcessor::URogueTrainSignalProcessor(): EntityQuery(*this)
+{
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::AllNetModes);
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+	ExecutionOrder.ExecuteAfter.Add(URogueTrainHeadwayProcessor::StaticClass()->GetFName());
+	ExecutionOrder.ExecuteBefore.Add(URogueTrainEngineMovementProcessor::StaticClass()->GetFName());
+}
+
+void URogueTrainSignalProcessor::ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager)
+{
+	EntityQuery.AddRequirement<FRogueTrainTrackFollowFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FRogueTrainStateFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddTagRequirement<FRogueTrainEngineTag>(EMassFragmentPresence::All);
+	EntityQuery.RegisterWithProcessor(*this);
+
+	ProcessorRequirements.AddSubsystemRequirement<URogueTrainWorldSubsystem>(EMassFragmentAccess::ReadWrite);
+}
+
+void URogueTrainSignalProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings || !Settings->bUseBlockSignalling) return;
+
+	auto* TrainSubsystem = Context.GetWorld()->GetSubsystem<URogueTrainWorldSubsystem>();
+	if (!TrainSubsystem) return;
+
+	const FRogueTrackSharedFragment& TrackSharedFragment = TrainSubsystem->GetTrackShared();
+	if (!TrackSharedFragment.IsValid() || !TrackSharedFragment.HasBlocks()) return;
+
+	const TArrayView<int32> BlockOwners = TrainSubsystem->GetMutableBlockOwners();
+	const TArrayView<int32> FirstBlocks = TrainSubsystem->GetMutableTrainFirstBlocks();
+	const TArrayView<int32> HeldBlocks = TrainSubsystem->GetMutableTrainHeldBlocks();
+	if (BlockOwners.Num() != TrackSharedFragment.NumBlocks) return;
+
+	const double TrackLength = TrackSharedFragment.TrackLength;
+	const double BlockLength = TrackSharedFragment.BlockLength;
+	const int32 NumBlocks = TrackSharedFragment.NumBlocks;
+	const float Deceleration = Settings->BrakingDeceleration;
+
+	auto BlockAt = [&](const double Distance)
+	{
+		return TrackSharedFragment.GetBlockIndex(RogueTrainUtility::WrapTrackDistance(Distance, TrackLength));
+	};
+	auto BlocksAhead = [&](const int32 From, const int32 To)
+	{
+		return (To - From + NumBlocks) % NumBlocks;
+	};
+
+	EntityQuery.ForEachEntityChunk(Context, [&](FMassExecutionContext& SubContext)
+	{
+		const TConstArrayView<FRogueTrainTrackFollowFragment> FollowView = SubContext.GetFragmentView<FRogueTrainTrackFollowFragment>();
+		const TArrayView<FRogueTrainStateFragment> StateView = SubContext.GetMutableFragmentView<FRogueTrainStateFragment>();
+
+		for (int32 i = 0; i < SubContext.GetNumEntities(); ++i)
+		{
+			const auto& Follow = FollowView[i];
+			auto& State = StateView[i];
+			State.SignalSpeedLimit = TNumericLimits<float>::Max();
+
+			const int32 Train = State.TrainIndex;
+			if (!FirstBlocks.IsValidIndex(Train)) continue;
+
+			int32& First = FirstBlocks[Train];
+			int32& Held = HeldBlocks[Train];
+			const int32 TailBlock = BlockAt(Follow.Distance - State.TrainLength);
+			const int32 HeadBlock = BlockAt(Follow.Distance);
+
+			// Release the blocks the tail has cleared
+			while (Held > 0 && First != TailBlock)
+			{
+				if (BlockOwners[First] == Train) BlockOwners[First] = INDEX_NONE;
+				First = (First + 1) % NumBlocks;
+				--Held;
+			}
+			if (Held == 0) First = TailBlock;
+
+			// Hold through the braking distance plus one block, stopping at the first block another train holds
+			const double BrakingDistance = FMath::Square(Follow.Speed) / (2.0 * Deceleration);
+			const int32 WantedBlocks = FMath::Min(NumBlocks - 1, BlocksAhead(First, BlockAt(Follow.Distance + BrakingDistance + BlockLength)) + 1);
+			while (Held < WantedBlocks)
+			{
+				const int32 Next = (First + Held) % NumBlocks;
+				if (BlockOwners[Next] != INDEX_NONE && BlockOwners[Next] != Train) break;
+
+				BlockOwners[Next] = Train;
+				++Held;
+			}
+
+			// Movement authority ends at the far edge of the last block held, none when the head block is not held
+			double Authority = 0.0;
+			if (BlocksAhead(First, HeadBlock) < Held)
+			{
+				const int32 LastBlock = (First + Held - 1) % NumBlocks;
+				Authority = RogueTrainUtility::ForwardDistanceWrapped(Follow.Distance, (LastBlock + 1) * BlockLength, TrackLength);
+			}
+
+			State.SignalSpeedLimit = static_cast<float>(FMath::Sqrt(2.0 * Deceleration * Authority));
+		}
+	});
+}
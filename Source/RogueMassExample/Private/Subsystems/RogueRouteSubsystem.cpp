@@ -0,0 +1,66 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Subsystems/RogueRouteSubsystem.h"
+#include "Async/ParallelFor.h"
+
+void URogueRouteSubsystem::Deinitialize()
+{
+	NumStations = 0;
+	NextHops.Empty();
+	
+	Super::Deinitialize();
+}
+
+void URogueRouteSubsystem::BuildRoutes(TConstArrayView<TArray<int32>> StationLines)
+{
+	NumStations = 0;
+	NextHops.Reset();
+	if (StationLines.Num() == 0 || StationLines.Num() >= NoHop) return;
+
+	// Invert to the stations on each line
+	TArray<TArray<int32>> LineStations;
+	for (int32 Station = 0; Station < StationLines.Num(); ++Station)
+	{
+		for (const int32 Line : StationLines[Station])
+		{
+			if (Line < 0) continue;
+			if (LineStations.Num() <= Line) LineStations.SetNum(Line + 1);
+			LineStations[Line].Add(Station);
+		}
+	}
+
+	NumStations = StationLines.Num();
+	NextHops.Init(NoHop, NumStations * NumStations);
+
+	// Breadth first back from each final station over the station-line graph, a station reached from S alights at S.
+	// Columns are independent, so finals run in parallel.
+	ParallelFor(NumStations, [&](const int32 Final)
+	{
+		TArray<int32> Frontier;
+		TBitArray<> VisitedStations(false, NumStations);
+		TBitArray<> VisitedLines(false, LineStations.Num());
+
+		Frontier.Add(Final);
+		VisitedStations[Final] = true;
+		NextHops[Final * NumStations + Final] = static_cast<uint16>(Final);
+
+		for (int32 Head = 0; Head < Frontier.Num(); ++Head)
+		{
+			const int32 Station = Frontier[Head];
+			for (const int32 Line : StationLines[Station])
+			{
+				if (Line < 0 || VisitedLines[Line]) continue;
+				VisitedLines[Line] = true;
+
+				for (const int32 Other : LineStations[Line])
+				{
+					if (VisitedStations[Other]) continue;
+					VisitedStations[Other] = true;
+					NextHops[Other * NumStations + Final] = static_cast<uint16>(Station);
+					Frontier.Add(Other);
+				}
+			}
+		}
+	});
+}
@@ -3,21 +3,41 @@
 
 #include "Subsystems/RogueTrainWorldSubsystem.h"
 #include "Data/RogueDeveloperSettings.h"
+#include "Subsystems/RogueRouteSubsystem.h"
 #include "EngineUtils.h"
 #include "MassCommonFragments.h"
 #include "MassEntityConfigAsset.h"
 #include "MassEntitySubsystem.h"
+#include "MassMovementFragments.h"
+#include "MassNavigationFragments.h"
 #include "MassRepresentationFragments.h"
 #include "MassSpawnerSubsystem.h"
 #include "Actors/RogueTrainStation.h"
 #include "Actors/RogueTrainTrack.h"
+#include "Data/RogueCookedTrack.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Rotate.h"
 #include "Avoidance/MassAvoidanceFragments.h"
 #include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
 #include "Components/SplineComponent.h"
+#include "Steering/MassSteeringFragments.h"
 #include "Utilities/RoguePassengerUtility.h"
 #include "Utilities/RogueStationQueueUtility.h"
 #include "Utilities/RogueTrainUtility.h"
 
+#if WITH_EDITOR
+static FAutoConsoleCommandWithWorld BakeTrackCommand(
+	TEXT("Rogue.BakeTrack"),
+	TEXT("Writes the cooked track file for the running world, run in PIE once all stations are created"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (auto* TrainSubsystem = World ? World->GetSubsystem<URogueTrainWorldSubsystem>() : nullptr)
+		{
+			TrainSubsystem->BakeCookedTrack();
+		}
+	}));
+#endif
 
 void URogueTrainWorldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
@@ -38,7 +58,21 @@ void URogueTrainWorldSubsystem::Deinitialize()
 	PendingSpawns.Reset();
 	EntityPool.Empty();
 	WorldEntities.Empty();
+	DormantFragments.Empty();
+	TrainEngines.Reset();
+	TrainHeadDistances.Reset();
+	TrainLengths.Reset();
+	TrainOrder.Reset();
+	BlockOwners.Reset();
+	TrainFirstBlocks.Reset();
+	TrainHeldBlocks.Reset();
+	NumVirtualRiders = 0;
 	StationActorData.Reset();
+	CachedTrack = FRogueTrackSharedFragment{};
+	TrackSamples.Empty();
+	BakedSpline.Reset();
+	CookedTrack.Reset();
+	bTrackConditioned = false;
 	TrackSpline = nullptr;
 	EntityManager = nullptr;
 
@@ -71,6 +105,11 @@ void URogueTrainWorldSubsystem::InitTemplateConfigs()
 	{
 		PassengerConfig = Settings->PassengerConfig.LoadSynchronous(); 
 	}
+	
+	if (!Settings->PassengerDemand.IsNull())
+	{
+		PassengerDemand = Settings->PassengerDemand.LoadSynchronous(); 
+	}
 }
 
 void URogueTrainWorldSubsystem::InitConfigTemplates(const UWorld& InWorld)
@@ -164,7 +203,22 @@ void URogueTrainWorldSubsystem::DiscoverSplineFromSettings()
 
 		if (TrackSpline.Get())
 		{
-			ResampleSplineUniform(*TrackSpline.Get(), Settings->TrackSplineResampleStep);
+			// Cooked track replaces the resample and station conditioning, hash is taken from the authored spline
+			TrackSourceHash = FRogueCookedTrack::ComputeSourceHash(*TrackSpline.Get(), *Settings);
+			if (Settings->bUseCookedTrack)
+			{
+				CookedTrack = FRogueCookedTrack::Load(FRogueCookedTrack::GetFilename(*Settings), TrackSourceHash);
+			}
+
+			if (CookedTrack)
+			{
+				CookedTrack->ApplyToSpline(*TrackSpline.Get());
+			}
+			else
+			{
+				ResampleSplineUniform(*TrackSpline.Get(), Settings->TrackSplineResampleStep);
+			}
+			BakedSpline.Reset();
 		}
 	}
 }
@@ -205,8 +259,19 @@ void URogueTrainWorldSubsystem::GatherStationActors()
 
 void URogueTrainWorldSubsystem::CreateStations()
 {
-	// Build platform data from settings
-	BuildStationPlatformData();
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings) return;
+
+	// Build platform data from settings, or take the cooked frames
+	if (CookedTrack)
+	{
+		Platforms = CookedTrack->GetPlatforms();
+	}
+	else
+	{
+		BuildStationPlatformData();
+		ConditionTrackForStations(Settings->TrackSplineResampleStep);
+	}
 	
 	// Check station data found
 	checkf(Platforms.Num() > 0, TEXT("No stations found! Configure station data in Settings."));
@@ -229,29 +294,60 @@ void URogueTrainWorldSubsystem::CreateStations()
 	}
 }
 
-void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRogueSpawnRequest& Request, const float ResampleDistance) const
+void URogueTrainWorldSubsystem::ConditionTrackForStations(const float ResampleDistance)
+{
+	if (bTrackConditioned) return;
+
+	USplineComponent* Spline = TrackSpline.Get();
+	if (!Spline || Platforms.Num() == 0) return;
+
+	// Point distances and platform centers are read once from the unedited spline, every window
+	// is applied to the point arrays and the spline is rebuilt a single time
+	Spline->UpdateSpline();
+	const float SplineLength = Spline->GetSplineLength();
+	const int32 NumPoints = Spline->GetNumberOfSplinePoints();
+	TArray<float> PointDistances;
+	PointDistances.SetNumUninitialized(NumPoints);
+	for (int32 i = 0; i < NumPoints; ++i)
+	{
+		PointDistances[i] = Spline->GetDistanceAlongSplineAtSplinePoint(i);
+	}
+
+	for (const FRoguePlatformData& PlatformData : Platforms)
+	{
+		ConfigureTrackToStation(PlatformData, ResampleDistance, SplineLength, PointDistances);
+	}
+
+	Spline->UpdateSpline();
+	bTrackConditioned = true;
+	bTrackDirty = true;
+	BakedSpline.Reset(); // points moved, the length alone may not show it
+}
+
+void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRoguePlatformData& PlatformData, const float ResampleDistance, const float SplineLength,
+	const TArray<float>& PointDistances) const
 {
 	USplineComponent* Spline = TrackSpline.Get();
 	if (!Spline) return;
 
-	const FVector Center = Request.PlatformData.Center;
-	const float PlatformLength = FMath::Max(1.f, Request.PlatformData.PlatformLength);
+	const FVector Center = PlatformData.Center;
+	const float PlatformLength = FMath::Max(1.f, PlatformData.PlatformLength);
 	const float PlatformHalfLength = PlatformLength * 0.5f;
 	const float SampleDistance = ResampleDistance + PlatformLength;
-	const float TrackOffset = Request.PlatformData.TrackOffset;
-	const float SplineLength = Spline->GetSplineLength();
-	const FVector Fwd = Request.PlatformData.Fwd;
-	const FVector Up = Request.PlatformData.Up;	
+	const float TrackOffset = PlatformData.TrackOffset;
+	const FVector Fwd = PlatformData.Fwd;
+	const FVector Up = PlatformData.Up;	
 	const FVector Right = FVector::CrossProduct(Up, Fwd).GetSafeNormal();
 	const int32 NumPoints = Spline->GetNumberOfSplinePoints();	
-	float DistCenter = Spline->GetDistanceAlongSplineAtLocation(Center, ESplineCoordinateSpace::World);
+	// The platform center was built from the track point at its alpha, no need to search the spline for it
+	float DistCenter = RogueTrainUtility::WrapTrackAlpha(PlatformData.Alpha) * SplineLength;
 	float DistStart = DistCenter - 0.5f * SampleDistance;
 	float DistEnd = DistCenter + 0.5f * SampleDistance;
 	const bool bWrap = (DistEnd < DistStart);
 
 	// Choose offset side
 	float Sign = +1.f;
-	EPlatformSide TrackSide = Request.PlatformData.TrackSide;
+	EPlatformSide TrackSide = PlatformData.TrackSide;
 	if (TrackSide == EPlatformSide::Left)  Sign = -1.f;
 	if (TrackSide == EPlatformSide::Auto)
 	{
@@ -265,17 +361,25 @@ void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRogueSpawnRequest
 	const FVector PlatformEndPos = Center + Fwd * PlatformHalfLength + Right * (Sign * TrackOffset);
 	const FVector PlatformDirection = (PlatformEndPos - PlatformStartPos).GetSafeNormal();
 
-	// Collect point indices inside [DistStart, DistEnd]
+	// Collect point indices inside [DistStart, DistEnd], point distances ascend so the window is found by binary search
 	TArray<int32> Window;
-	for (int32 i = 0; i < NumPoints; ++i)
+	auto AddRange = [&](const float From, const float To)
 	{
-		const float PointDistance = Spline->GetDistanceAlongSplineAtSplinePoint(i);
-
-		// Check if point is within platform distance window
-		if ((!bWrap && PointDistance >= DistStart && PointDistance <= DistEnd) || ( bWrap && (PointDistance >= DistStart || PointDistance <= DistEnd)))
+		const int32 First = Algo::LowerBound(PointDistances, From);
+		const int32 Last = Algo::UpperBound(PointDistances, To);
+		for (int32 i = First; i < Last; ++i)
 		{
 			Window.Add(i);
 		}
+	};
+	if (bWrap)
+	{
+		AddRange(-MAX_flt, DistEnd);
+		AddRange(DistStart, MAX_flt);
+	}
+	else
+	{
+		AddRange(DistStart, DistEnd);
 	}
 	if (Window.Num() == 0) return;
 	
@@ -286,7 +390,7 @@ void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRogueSpawnRequest
 		float BestEndDist = FLT_MAX;
 		for (const int32 Point : Window)
 		{
-			float PointDistance = Spline->GetDistanceAlongSplineAtSplinePoint(Point);
+			float PointDistance = PointDistances[Point];
 			if (bWrap && PointDistance < DistStart)
 			{
 				PointDistance += SplineLength;
@@ -332,7 +436,7 @@ void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRogueSpawnRequest
 	const FRotator PlatformRotation = FRotationMatrix::MakeFromXZ(PlatformDirection, Up).Rotator();
 	for (const int32 PointIndex : Window)
 	{
-		const float PointDistance = Spline->GetDistanceAlongSplineAtSplinePoint(PointIndex);
+		const float PointDistance = PointDistances[PointIndex];
 		const float PointAlpha = DistToT(PointDistance);
 		const FVector PointPosition = FMath::Lerp(PlatformStartPos, PlatformEndPos, PointAlpha);
 
@@ -366,8 +470,6 @@ void URogueTrainWorldSubsystem::ConfigureTrackToStation(const FRogueSpawnRequest
 	const float StartMagnitude = StartLength * 0.5f;
 	const FVector StartTangent = StartDirection * StartMagnitude;
 	Spline->SetTangentAtSplinePoint(PlatformStartIndex, StartTangent, ESplineCoordinateSpace::World, false);	
-	
-	Spline->UpdateSpline();	
 }
 
 void URogueTrainWorldSubsystem::GetStationSide(const FRoguePlatformData& PlatformData, const FTransform& StationTransform, float& Out)
@@ -397,21 +499,23 @@ void URogueTrainWorldSubsystem::BuildStationPlatformData()
 	const TWeakObjectPtr<USplineComponent> Spline = TrackSpline.Get();
 	if (!Spline.IsValid()) return;
 
-	// Copy and sort by alpha so next station is defined correctly
-	TArray<FRogueStationConfig> Stations = Settings->Stations;
-	Algo::SortBy(Stations, &FRogueStationConfig::TrackAlpha);
+	// Sort settings indices by alpha so next station is defined correctly, station index i is Platforms[i] from here on
+	TArray<int32> ConfigOrder;
+	for (int32 i = 0; i < Settings->Stations.Num(); ++i) ConfigOrder.Add(i);
+	Algo::SortBy(ConfigOrder, [Settings](const int32 ConfigIdx) { return Settings->Stations[ConfigIdx].TrackAlpha; });
 	
 	Platforms.Reset();
 
 	// Create platform data for each station in alpha order
 	TArray<float> StationTrackAlphas;
-	for (int i = 0; i < Stations.Num(); ++i)
+	for (const int32 ConfigIdx : ConfigOrder)
 	{
-		const FRogueStationConfig& StationConfigData = Stations[i];
+		const FRogueStationConfig& StationConfigData = Settings->Stations[ConfigIdx];
 		StationTrackAlphas.Add(RogueTrainUtility::WrapTrackAlpha(StationConfigData.TrackAlpha));
 		
 		FRoguePlatformData PlatformSegment;
 		RogueTrainUtility::BuildPlatformSegment(*Spline, StationConfigData, PlatformSegment);
+		PlatformSegment.ConfigIndex = ConfigIdx;
 		Platforms.Add(MoveTemp(PlatformSegment));
 	}
 }
@@ -446,15 +550,16 @@ void URogueTrainWorldSubsystem::CreateTrains()
 		const float T1 = TrackSharedFragment.GetStationAlphaByIndex(NextIdx);
 		const float dT = RogueTrainUtility::ArcDistanceWrapped(T0, T1);
 		const float Frac = (Passes <= 1) ? 0.f : static_cast<float>(PassIdx) / static_cast<float>(Passes);
-		const float TrainAlpha = RogueTrainUtility::WrapTrackAlpha(T0 + dT * Frac);
+		// Station alphas are authored, everything past here is in cm along the track
+		const double TrainDistance = RogueTrainUtility::WrapTrackAlpha(T0 + dT * Frac) * TrackSharedFragment.TrackLength;
 
-		// Compute full consist placement from this head alpha
+		// Compute full consist placement from this head distance
 		TArray<FRoguePlacedCar> Placement;
-		RogueTrainUtility::ComputeConsistPlacement(TrackSharedFragment, TrainAlpha, CarriagesPer, Placement);
+		RogueTrainUtility::ComputeConsistPlacement(TrackSharedFragment, TrainDistance, CarriagesPer, Placement);
 		if (Placement.Num() == 0) continue;
 
 		RogueTrainUtility::FSplineStationSample Sample;
-		if (!RogueTrainUtility::GetSplineSample(TrackSharedFragment, TrainAlpha, Sample))
+		if (!RogueTrainUtility::GetSplineSample(TrackSharedFragment, TrainDistance, Sample))
 		{
 			/*Along*/ //0.f,        // e.g. +100.f to place a bit ahead
 			/*Lateral*/ //0.f,      // e.g. +150.f to offset to platform side
@@ -467,7 +572,7 @@ void URogueTrainWorldSubsystem::CreateTrains()
 		Request.EntityTemplate = TrainEngineTemplate;
 		Request.RemainingCount = 1;
 		Request.Transform = Placement[0].Transform;               // with ride height
-		Request.StartAlpha = Placement[0].Alpha;
+		Request.StartDistance = Placement[0].Distance;
 		Request.StationIdx = StationIdx;
 
 		TWeakObjectPtr<URogueTrainWorldSubsystem> TrainSubsystemWeak = this;
@@ -492,7 +597,7 @@ void URogueTrainWorldSubsystem::CreateTrains()
 				CarriageRequest.CarriageIndex = c;
 				CarriageRequest.Spacing = DerivedSpacing;
 				CarriageRequest.CarriageCapacity = CapacityPerCar;
-				CarriageRequest.StartAlpha = Placement[c].Alpha;
+				CarriageRequest.StartDistance = Placement[c].Distance;
 				CarriageRequest.Transform = Placement[c].Transform;
 
 				TrainSubsystemLocal->EnqueueSpawns(CarriageRequest);
@@ -508,16 +613,70 @@ void URogueTrainWorldSubsystem::BuildTrackSharedData()
 	const auto* Settings = GetDefault<URogueDeveloperSettings>();
 	if (!Settings) return;
 	
-	CachedTrack = FRogueTrackSharedFragment{};
-	CachedTrack.Spline = TrackSpline.Get();
-	if (!CachedTrack.Spline.IsValid()) return;
+	const USplineComponent* Spline = TrackSpline.Get();
+	if (!Spline)
+	{
+		CachedTrack = FRogueTrackSharedFragment{};
+		BakedSpline.Reset();
+		return;
+	}
 
-	const USplineComponent& Spline = *CachedTrack.Spline.Get();
+	// Station spawns and settings edits only touch station data, samples and blocks are kept unless the spline changed
+	const double SplineLength = Spline->GetSplineLength();
+	if (BakedSpline.Get() != Spline || BakedSplineLength != SplineLength)
+	{
+		BakeTrackGeometry(*Settings, *Spline);
+	}
+	
+	BuildStationSharedData();
+	bTrackDirty = false;
+	++TrackRevision;
+}
+
+void URogueTrainWorldSubsystem::BakeTrackGeometry(const URogueDeveloperSettings& Settings, const USplineComponent& Spline)
+{
+	CachedTrack = FRogueTrackSharedFragment{};
+	CachedTrack.Spline = TrackSpline;
 	CachedTrack.TrackLength = Spline.GetSplineLength();
+	BakedSpline = &Spline;
+	BakedSplineLength = CachedTrack.TrackLength;
+
+	// Bake the sample table once so movement never has to evaluate the spline, the cooked table is used in place
+	if (CookedTrack && CookedTrack->GetSamples().Num() > 1)
+	{
+		CachedTrack.Samples = CookedTrack->GetSamples();
+		CachedTrack.SampleStep = CookedTrack->GetSampleStep();
+	}
+	else
+	{
+		RogueTrainUtility::BuildTrackSamples(Spline, Settings.TrackSampleStep, TrackSamples, CachedTrack.SampleStep);
+		CachedTrack.Samples = TrackSamples;
+	}
+	CachedTrack.InvSampleStep = (CachedTrack.SampleStep > 0.0) ? 1.0 / CachedTrack.SampleStep : 0.0;
+
+	// Signal blocks, every reservation is dropped since block boundaries move with the track length
+	BlockOwners.Reset();
+	if (Settings.bUseBlockSignalling && CachedTrack.TrackLength > 0.0)
+	{
+		CachedTrack.NumBlocks = FMath::Max(2, FMath::RoundToInt32(CachedTrack.TrackLength / FMath::Max(100.0, static_cast<double>(Settings.SignalBlockLength))));
+		CachedTrack.BlockLength = CachedTrack.TrackLength / CachedTrack.NumBlocks;
+		BlockOwners.Init(INDEX_NONE, CachedTrack.NumBlocks);
+	}
+	for (int32 i = 0; i < TrainFirstBlocks.Num(); ++i)
+	{
+		TrainFirstBlocks[i] = INDEX_NONE;
+		TrainHeldBlocks[i] = 0;
+	}
+}
 
-	if (Platforms.Num() == 0) return;
+void URogueTrainWorldSubsystem::BuildStationSharedData()
+{
 	CachedTrack.StationEntities.Reset(Platforms.Num());
 	CachedTrack.Platforms.Reset(Platforms.Num());
+	CachedTrack.StationAlphas.Reset(Platforms.Num());
+	
+	TArray<TPair<double, int32>> Docks;
+	Docks.Reserve(Platforms.Num());
 	
 	for (int i = 0; i < Platforms.Num(); ++i)
 	{
@@ -528,10 +687,19 @@ void URogueTrainWorldSubsystem::BuildTrackSharedData()
 		}
 		
 		CachedTrack.Platforms.Add(Platforms[i]);
+		CachedTrack.StationAlphas.Add(CachedTrack.GetStationAlphaByIndex(i)); // not cached yet, evaluates the spline once
+		Docks.Emplace(Platforms[i].DockDistance, i);
 	}
 
-	bTrackDirty = false;
-	++TrackRevision;
+	// Sorted dock index for next station lookups
+	Docks.Sort([](const TPair<double, int32>& A, const TPair<double, int32>& B) { return A.Key < B.Key; });
+	CachedTrack.SortedDockDistances.Reset(Docks.Num());
+	CachedTrack.SortedDockStations.Reset(Docks.Num());
+	for (const TPair<double, int32>& Dock : Docks)
+	{
+		CachedTrack.SortedDockDistances.Add(Dock.Key);
+		CachedTrack.SortedDockStations.Add(Dock.Value);
+	}
 }
 
 const FRogueTrackSharedFragment& URogueTrainWorldSubsystem::GetTrackShared()
@@ -546,6 +714,23 @@ void URogueTrainWorldSubsystem::EnqueueSpawns(const FRogueSpawnRequest& Request)
 	PendingSpawns.Add(Request);
 }
 
+void URogueTrainWorldSubsystem::EnqueueSpawns(FRogueSpawnRequest&& Request)
+{
+	if (!Request.EntityTemplate->IsValid() || Request.RemainingCount <= 0) return;
+	PendingSpawns.Add(MoveTemp(Request));
+}
+
+int32 URogueTrainWorldSubsystem::GetPendingSpawnCount(const ERogueEntityType Type) const
+{
+	int32 Count = 0;
+	for (const FRogueSpawnRequest& Request : PendingSpawns)
+	{
+		if (Request.Type == Type) Count += Request.RemainingCount;
+	}
+	
+	return Count;
+}
+
 void URogueTrainWorldSubsystem::ProcessPendingSpawns()
 {
 	if (!EntityManager || PendingSpawns.Num() == 0) return;
@@ -554,16 +739,22 @@ void URogueTrainWorldSubsystem::ProcessPendingSpawns()
 	if (!Settings) return;
 
 	int32 Budget = Settings->MaxSpawnsPerFrame;	
+	int32 PassengerBatchBudget = Settings->MaxPassengerSpawnsPerTick;
+	bool bFlushBatches = false;
 
 	auto* Spawner = GetWorld()->GetSubsystem<UMassSpawnerSubsystem>();
 	auto* MassEntitySubsystem = GetWorld()->GetSubsystem<UMassEntitySubsystem>();
 	if (!Spawner || !MassEntitySubsystem) return;
 
 	// reverse so we can RemoveAtSwap
-	for (int32 i = PendingSpawns.Num()-1; i >= 0 && Budget > 0; --i)
+	for (int32 i = PendingSpawns.Num()-1; i >= 0 && (Budget > 0 || PassengerBatchBudget > 0); --i)
 	{
 		FRogueSpawnRequest& Request = PendingSpawns[i];
-		const int32 ThisBatch = FMath::Min(Request.RemainingCount, Budget);
+		const bool bBatched = Request.Type == ERogueEntityType::Passenger && Request.PassengerPayloads.Num() > 0;
+		int32& RequestBudget = bBatched ? PassengerBatchBudget : Budget;
+		if (RequestBudget <= 0) continue;
+		
+		const int32 ThisBatch = FMath::Min(Request.RemainingCount, RequestBudget);
 
 		TArray<FMassEntityHandle> NewEntities;
 		const int32 Reused = RetrievePooledEntities(Request.Type, ThisBatch, NewEntities);
@@ -576,15 +767,24 @@ void URogueTrainWorldSubsystem::ProcessPendingSpawns()
 			NewEntities.Append(Spawned);
 		}
 
-		// Configure fragments/tags/position here (per entity)
-		FMassEntityManager& EntityManagerMutable = MassEntitySubsystem->GetMutableEntityManager();
-		for (const FMassEntityHandle NewEntity : NewEntities)
+		if (bBatched)
+		{
+			// Initial values pushed as commands and applied together per archetype in the flush below
+			ConfigurePassengerBatch(Request, NewEntities, Reused);
+			bFlushBatches = true;
+		}
+		else
 		{
-			RegisterEntity(Request.Type, NewEntity);
-			ConfigureSpawnedEntity(Request, NewEntity);
+			// Configure fragments/tags/position here (per entity)
+			FMassEntityManager& EntityManagerMutable = MassEntitySubsystem->GetMutableEntityManager();
+			for (const FMassEntityHandle NewEntity : NewEntities)
+			{
+				RegisterEntity(Request.Type, NewEntity);
+				ConfigureSpawnedEntity(Request, NewEntity);
 
-			// clear pool marker if present
-			EntityManagerMutable.Defer().PushCommand<FMassCommandRemoveTag<FRoguePooledEntityTag>>(NewEntity);
+				// clear pool marker if present
+				EntityManagerMutable.Defer().PushCommand<FMassCommandRemoveTag<FRoguePooledEntityTag>>(NewEntity);
+			}
 		}
 		
 		if (Request.OnSpawned)
@@ -594,13 +794,19 @@ void URogueTrainWorldSubsystem::ProcessPendingSpawns()
 		}
 
 		Request.RemainingCount -= ThisBatch;
-		Budget -= ThisBatch;
+		RequestBudget -= ThisBatch;
 
 		if (Request.RemainingCount <= 0)
 		{
 			PendingSpawns.RemoveAtSwap(i);
 		}
 	}
+
+	// Runs from the spawn timer outside Mass processing, batched passengers are complete before the next phase
+	if (bFlushBatches)
+	{
+		EntityManager->FlushCommands();
+	}
 }
 
 void URogueTrainWorldSubsystem::ResampleSplineUniform(USplineComponent& Spline, float Step)
@@ -667,6 +873,23 @@ void URogueTrainWorldSubsystem::EnqueueEntityToPool(const FMassEntityHandle Enti
 	// mark pooled
 	Context.Defer().PushCommand<FMassCommandAddTag<FRoguePooledEntityTag>>(Entity);
 
+	// Move to the dormant archetype, no movement or avoidance processor visits it and it leaves the obstacle grid
+	const TArray<FInstancedStruct>& Dormant = GetDormantFragments(Type, Entity);
+	if (Dormant.Num() > 0)
+	{
+		TArray<const UScriptStruct*> DormantTypes;
+		DormantTypes.Reserve(Dormant.Num());
+		for (const FInstancedStruct& Fragment : Dormant)
+		{
+			DormantTypes.Add(Fragment.GetScriptStruct());
+		}
+		
+		Context.Defer().PushCommand<FMassDeferredChangeCompositionCommand>([Entity, DormantTypes = MoveTemp(DormantTypes)](FMassEntityManager& Manager)
+		{
+			Manager.RemoveFragmentListFromEntity(Entity, DormantTypes);
+		});
+	}
+
 	EntityPool.FindOrAdd(Type).Add(Entity);
 }
 
@@ -678,6 +901,13 @@ int32 URogueTrainWorldSubsystem::RetrievePooledEntities(const ERogueEntityType T
 	{
 		FMassEntityHandle EntityHandle = Pool.Pop(EAllowShrinking::No);
 		if (!EntityHandle.IsValid()) continue;
+
+		// Restored in place rather than deferred, the spawn manager configures these fragments straight after
+		const TArray<FInstancedStruct>* Dormant = DormantFragments.Find(Type);
+		if (EntityManager && Dormant && Dormant->Num() > 0 && !EntityManager->GetFragmentDataStruct(EntityHandle, (*Dormant)[0].GetScriptStruct()).IsValid())
+		{
+			EntityManager->AddFragmentInstanceListToEntity(EntityHandle, *Dormant);
+		}
 		
 		Out.Add(EntityHandle);
 	}
@@ -705,6 +935,52 @@ const FMassEntityTemplate* URogueTrainWorldSubsystem::GetPassengerTemplate() con
 	return PassengerTemplate.IsValid() ? &PassengerTemplate : nullptr;
 }
 
+const FMassEntityTemplate* URogueTrainWorldSubsystem::GetTemplateByType(const ERogueEntityType Type) const
+{
+	switch (Type)
+	{
+		case ERogueEntityType::Station: return GetStationTemplate();
+		case ERogueEntityType::TrainEngine: return GetTrainTemplate();
+		case ERogueEntityType::TrainCarriage: return GetCarriageTemplate();
+		case ERogueEntityType::Passenger: return GetPassengerTemplate();
+		default: return nullptr;
+	}
+}
+
+const TArray<FInstancedStruct>& URogueTrainWorldSubsystem::GetDormantFragments(const ERogueEntityType Type, const FMassEntityHandle Entity)
+{
+	if (const TArray<FInstancedStruct>* Found = DormantFragments.Find(Type)) return *Found;
+
+	// Resolved from the first entity of this type that is pooled, each present fragment restores to its template value
+	const UScriptStruct* const DormantTypes[] = {
+		FMassVelocityFragment::StaticStruct(),
+		FMassForceFragment::StaticStruct(),
+		FMassMoveTargetFragment::StaticStruct(),
+		FMassSteeringFragment::StaticStruct(),
+		FMassStandingSteeringFragment::StaticStruct(),
+		FMassGhostLocationFragment::StaticStruct(),
+		FMassAvoidanceColliderFragment::StaticStruct(),
+		FMassNavigationEdgesFragment::StaticStruct(),
+		FMassNavigationObstacleGridCellLocationFragment::StaticStruct()
+	};
+	
+	TArray<FInstancedStruct>& Fragments = DormantFragments.Add(Type);
+	if (!EntityManager || !EntityManager->IsEntityValid(Entity)) return Fragments;
+
+	const FMassEntityTemplate* Template = GetTemplateByType(Type);
+	for (const UScriptStruct* Struct : DormantTypes)
+	{
+		if (!EntityManager->GetFragmentDataStruct(Entity, Struct).IsValid()) continue;
+
+		const FInstancedStruct* Initial = Template
+			? Template->GetInitialFragmentValues().FindByPredicate([Struct](const FInstancedStruct& Value) { return Value.GetScriptStruct() == Struct; })
+			: nullptr;
+		Fragments.Add(Initial ? *Initial : FInstancedStruct(Struct));
+	}
+
+	return Fragments;
+}
+
 void URogueTrainWorldSubsystem::OnWorldBeginPlay(UWorld& InWorld)
 {
 	Super::OnWorldBeginPlay(InWorld);
@@ -763,7 +1039,7 @@ void URogueTrainWorldSubsystem::ConfigureStation(const FRogueSpawnRequest& Reque
 	// Add station entity with alpha key
 	StationEntities.Add(Request.StationIdx, Entity);
 
-	// Mark track dirty to rebuild cached data
+	// Mark track dirty to rebuild the station data, the baked samples and blocks are kept
 	bTrackDirty = true;
 				
 	if (auto* StationFragment = EntityManager->GetFragmentDataPtr<FRogueStationFragment>(Entity))
@@ -781,12 +1057,28 @@ void URogueTrainWorldSubsystem::ConfigureStation(const FRogueSpawnRequest& Reque
 		QueueFragment->Grids.Reset();
 		for (int WaitIdx = 0; WaitIdx < QueueFragment->WaitingPoints.Num(); ++WaitIdx)
 		{
+			if (const TArray<FVector>* CookedSlots = CookedTrack ? CookedTrack->GetGridSlots(Request.StationIdx, WaitIdx) : nullptr)
+			{
+				QueueFragment->Grids.AddGrid(*CookedSlots);
+				continue;
+			}
+			
 			const FVector WaitingPoint = QueueFragment->WaitingPoints[WaitIdx];
 			RogueStationQueueUtility::BuildGridForWaitingPoint(Request.PlatformData, *QueueFragment, WaitingPoint, WaitIdx);					
 		}
-	}
+		RoguePassengerQueueUtility::ResetQueues(*QueueFragment);
 
-	ConfigureTrackToStation(Request, Settings->TrackSplineResampleStep);
+		// Platforms are straight, nearest waiting and exit points come from a sorted coordinate along them
+		QueueFragment->WaitingPointLine.Build(QueueFragment->WaitingPoints, Request.PlatformData.Center, Request.PlatformData.Fwd);
+		QueueFragment->SpawnPointLine.Build(QueueFragment->SpawnPoints, Request.PlatformData.Center, Request.PlatformData.Fwd);
+
+		// Traced once here so the height pass can snap passengers on the platform by lookup
+		RogueStationQueueUtility::BuildPlatformHeightField(GetWorld(), Request.PlatformData, *QueueFragment, Settings->PlatformHeightCellSize);
+		if (Settings->bUsePassengerFlowFields)
+		{
+			RogueStationQueueUtility::BuildPlatformFlowFields(*QueueFragment);
+		}
+	}
 
 	const int32 Slot = GetStationDebugIndex();
 	if (auto* DebugSlotFragment = EntityManager->GetFragmentDataPtr<FRogueDebugSlotFragment>(Entity))
@@ -805,6 +1097,21 @@ void URogueTrainWorldSubsystem::ConfigureStation(const FRogueSpawnRequest& Reque
 		{
 			TrackActors[i]->BuildTrackMeshes();
 		}
+
+		// Next hop table for journeys with transfers
+		if (auto* RouteSubsystem = GetWorld()->GetSubsystem<URogueRouteSubsystem>())
+		{
+			// By station index, the lines come from the settings entry each platform was built from
+			TArray<TArray<int32>> StationLines;
+			StationLines.SetNum(Platforms.Num());
+			for (int32 i = 0; i < Platforms.Num(); ++i)
+			{
+				const int32 ConfigIdx = Platforms[i].ConfigIndex;
+				if (Settings->Stations.IsValidIndex(ConfigIdx)) StationLines[i] = Settings->Stations[ConfigIdx].Lines;
+				if (StationLines[i].Num() == 0) StationLines[i].Add(0);
+			}
+			RouteSubsystem->BuildRoutes(StationLines);
+		}
 				
 		CreateTrains();
 	}
@@ -822,6 +1129,9 @@ void URogueTrainWorldSubsystem::ConfigureTrain(const FRogueSpawnRequest& Request
 
 	if (!EntityManager) return;
 
+	const double StartDistance = Request.StartDistance;
+	const float StartAlpha = static_cast<float>(StartDistance / FMath::Max(1.0, GetTrackShared().TrackLength));
+
 	if (auto* State = EntityManager->GetFragmentDataPtr<FRogueTrainStateFragment>(Entity))
 	{
 		State->bAtStation = true;
@@ -829,18 +1139,22 @@ void URogueTrainWorldSubsystem::ConfigureTrain(const FRogueSpawnRequest& Request
 		State->PreviousStationIdx = Request.StationIdx;
 		State->StationTimeRemaining = 2.f;
 		State->Carriages.Reset(Settings->CarriagesPerTrain);
+		State->TrainIndex = RegisterTrain(Entity, StartDistance);
+		State->PrevDistance = StartDistance;
 	}
 				
 	if (auto* Follow = EntityManager->GetFragmentDataPtr<FRogueTrainTrackFollowFragment>(Entity))
 	{
-		Follow->Alpha = Request.StartAlpha;
+		Follow->Distance = StartDistance;
+		Follow->Alpha = StartAlpha;
 		Follow->Speed = 0.f;
 	}
 	else
 	{
 		// Move entity to an archetype that contains this fragment and initialize it
 		FRogueTrainTrackFollowFragment InitFollow;
-		InitFollow.Alpha = Request.StartAlpha;
+		InitFollow.Distance = StartDistance;
+		InitFollow.Alpha = StartAlpha;
 		InitFollow.Speed = 0.f;
 
 		EntityManager->Defer().PushCommand<FMassCommandAddFragmentInstances>(Entity, InitFollow);
@@ -863,9 +1177,12 @@ void URogueTrainWorldSubsystem::ConfigureCarriage(const FRogueSpawnRequest& Requ
 
 	if (!EntityManager) return;
 
+	auto* TrainStateFragment = EntityManager->GetFragmentDataPtr<FRogueTrainStateFragment>(Request.LeadHandle);
+
 	if (auto* Link = EntityManager->GetFragmentDataPtr<FRogueTrainLinkFragment>(Entity))
 	{
 		Link->LeadHandle = Request.LeadHandle;
+		Link->TrainIndex = TrainStateFragment ? TrainStateFragment->TrainIndex : INDEX_NONE;
 		Link->CarriageIndex= Request.CarriageIndex;
 		Link->Spacing= Request.Spacing;
 	}
@@ -873,14 +1190,15 @@ void URogueTrainWorldSubsystem::ConfigureCarriage(const FRogueSpawnRequest& Requ
 	if (auto* CarriageFragment = EntityManager->GetFragmentDataPtr<FRogueCarriageFragment>(Entity))
 	{
 		CarriageFragment->Capacity = Request.CarriageCapacity;
-		CarriageFragment->Occupants.Reserve(Request.CarriageCapacity);
+		CarriageFragment->OccupantBuckets.Reset();
+		CarriageFragment->NumOccupants = 0;
 		CarriageFragment->NextAllowedUnloadTime = GetWorld()->GetTimeSeconds() + FMath::FRandRange(0.f, Settings->UnloadStartJitter);
-		CarriageFragment->UnloadCursor = 0;
 	}
 				
 	if (auto* Follow = EntityManager->GetFragmentDataPtr<FRogueTrainTrackFollowFragment>(Entity))
 	{
-		Follow->Alpha = Request.StartAlpha;
+		Follow->Distance = Request.StartDistance;
+		Follow->Alpha = static_cast<float>(Request.StartDistance / FMath::Max(1.0, GetTrackShared().TrackLength));
 		Follow->Speed = 0.f;
 	}
 
@@ -893,7 +1211,7 @@ void URogueTrainWorldSubsystem::ConfigureCarriage(const FRogueSpawnRequest& Requ
 		}				
 	}
 
-	if (auto* TrainStateFragment = EntityManager->GetFragmentDataPtr<FRogueTrainStateFragment>(Request.LeadHandle))
+	if (TrainStateFragment)
 	{
 		TrainStateFragment->Carriages.Add(Entity);
 	}
@@ -912,14 +1230,19 @@ void URogueTrainWorldSubsystem::ConfigurePassenger(const FRogueSpawnRequest& Req
 	{
 		PassengerFragment->OriginStation = Request.OriginStation;
 		PassengerFragment->DestinationStation = Request.DestinationStation;
+		PassengerFragment->RouteIndex = Request.RouteIndex;
 		PassengerFragment->VehicleHandle = FMassEntityHandle();
 		PassengerFragment->MaxSpeed = Request.MaxSpeed;
 		PassengerFragment->Target = Request.Transform.GetLocation();
 		PassengerFragment->WaitingPointIdx = INDEX_NONE;
 		PassengerFragment->WaitingSlotIdx = INDEX_NONE;
 		PassengerFragment->bWaiting = false;
-		PassengerFragment->Phase = ERoguePassengerPhase::EnteredWorld;
+		PassengerFragment->Phase = Request.InitialPhase;
 	}
+
+	// Reused from the pool, clear any phase tag left from the previous life
+	EntityManager->Defer().PushCommand<FMassCommandRemoveTag<FRoguePassengerQueuedTag>>(Entity);
+	EntityManager->Defer().PushCommand<FMassCommandRemoveTag<FRoguePassengerRidingTag>>(Entity);
 	if (auto* RadiusFragment = EntityManager->GetFragmentDataPtr<FAgentRadiusFragment>(Entity))
 	{
 		RadiusFragment->Radius = Settings->PassengerRadius; 
@@ -937,6 +1260,96 @@ void URogueTrainWorldSubsystem::ConfigurePassenger(const FRogueSpawnRequest& Req
 	RoguePassengerUtility::ShowPassenger(*EntityManager, Entity, Request.Transform.GetLocation());
 }
 
+void URogueTrainWorldSubsystem::ConfigurePassengerBatch(const FRogueSpawnRequest& Request, TConstArrayView<FMassEntityHandle> Entities, const int32 NumReused)
+{
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings || !EntityManager) return;
+
+	// Payloads are consumed front to back across frames as the request is drained
+	const int32 FirstPayload = Request.PassengerPayloads.Num() - Request.RemainingCount;
+	FMassCommandBuffer& Commands = EntityManager->Defer();
+
+	FAgentRadiusFragment Radius;
+	Radius.Radius = Settings->PassengerRadius;
+	
+	for (int32 k = 0; k < Entities.Num(); ++k)
+	{
+		const FMassEntityHandle Entity = Entities[k];
+		const FRoguePassengerSpawnPayload& Payload = Request.PassengerPayloads[FirstPayload + k];
+		RegisterEntity(ERogueEntityType::Passenger, Entity);
+
+		FRoguePassengerFragment Passenger;
+		Passenger.OriginStation = Request.OriginStation;
+		Passenger.DestinationStation = Payload.DestinationStation;
+		Passenger.RouteIndex = Payload.RouteIndex;
+		Passenger.BoardingPriority = Payload.BoardingPriority;
+		Passenger.MaxSpeed = Request.MaxSpeed;
+		Passenger.Target = Payload.Location;
+		Passenger.Phase = Request.InitialPhase;
+
+		const FTransformFragment Transform(FTransform(Request.Transform.GetRotation(), Payload.Location));
+
+		if (k < NumReused)
+		{
+			// Reused from the pool, keeps its debug slot and drops the pool and phase tags of its previous life
+			Commands.PushCommand<FMassCommandAddFragmentInstances>(Entity, Transform, Passenger, Radius);
+			Commands.PushCommand<FMassCommandRemoveTag<FRoguePooledEntityTag>>(Entity);
+			Commands.PushCommand<FMassCommandRemoveTag<FRoguePassengerQueuedTag>>(Entity);
+			Commands.PushCommand<FMassCommandRemoveTag<FRoguePassengerRidingTag>>(Entity);
+			RoguePassengerUtility::ShowPassenger(*EntityManager, Entity, FVector::ZeroVector); // LOD only, transform comes from the command
+			continue;
+		}
+
+		FRogueDebugSlotFragment DebugSlot;
+		DebugSlot.Slot = GetPassengerDebugSlot();
+		Commands.PushCommand<FMassCommandAddFragmentInstances>(Entity, Transform, Passenger, Radius, DebugSlot);
+	}
+}
+
+int32 URogueTrainWorldSubsystem::RegisterTrain(const FMassEntityHandle Engine, const double HeadDistance)
+{
+	const int32 TrainIndex = TrainEngines.Add(Engine);
+	TrainHeadDistances.Add(HeadDistance);
+	TrainLengths.Add(0.f);
+	TrainOrder.Add(TrainIndex); // out of place until the next repair
+	TrainFirstBlocks.Add(INDEX_NONE);
+	TrainHeldBlocks.Add(0);
+	return TrainIndex;
+}
+
+void URogueTrainWorldSubsystem::RepairTrainOrder()
+{
+	const int32 Num = TrainOrder.Num();
+	if (Num <= 2) return; // any order of two is a valid ring
+
+	// A ring sorted by head distance has at most one descent, where the order wraps past zero
+	int32 Descents = 0;
+	int32 MinPos = 0;
+	for (int32 i = 0; i < Num; ++i)
+	{
+		const double Current = TrainHeadDistances[TrainOrder[i]];
+		if (Current > TrainHeadDistances[TrainOrder[(i + 1) % Num]]) ++Descents;
+		if (Current < TrainHeadDistances[TrainOrder[MinPos]]) MinPos = i;
+	}
+
+	if (Descents <= 1) return;
+
+	// Start the ring at the rearmost train, then insertion sort; an overtake only leaves a few inversions
+	Algo::Rotate(TrainOrder, MinPos);
+	for (int32 i = 1; i < Num; ++i)
+	{
+		const int32 Index = TrainOrder[i];
+		const double Distance = TrainHeadDistances[Index];
+		int32 j = i - 1;
+		while (j >= 0 && TrainHeadDistances[TrainOrder[j]] > Distance)
+		{
+			TrainOrder[j + 1] = TrainOrder[j];
+			--j;
+		}
+		TrainOrder[j + 1] = Index;
+	}
+}
+
 void URogueTrainWorldSubsystem::RegisterEntity(const ERogueEntityType Type, const FMassEntityHandle Entity)
 {
 	GetEntitiesFromWorldByType(Type).Add(Entity);
@@ -972,6 +1385,15 @@ void URogueTrainWorldSubsystem::PostEditChangeProperty(FPropertyChangedEvent& Ev
 	if (Event.Property && Event.Property->GetOwnerClass() == URogueDeveloperSettings::StaticClass())
 	{
 		bTrackDirty = true;
+
+		// Only the sample and block settings need a rebake, everything else is station data
+		const FName PropertyName = Event.Property->GetFName();
+		if (PropertyName == GET_MEMBER_NAME_CHECKED(URogueDeveloperSettings, TrackSampleStep)
+			|| PropertyName == GET_MEMBER_NAME_CHECKED(URogueDeveloperSettings, bUseBlockSignalling)
+			|| PropertyName == GET_MEMBER_NAME_CHECKED(URogueDeveloperSettings, SignalBlockLength))
+		{
+			BakedSpline.Reset();
+		}
 	}
 }
 
@@ -1015,18 +1437,43 @@ void URogueTrainWorldSubsystem::DrawDebugStations(const UWorld* InWorld)
 
 			if (Settings->bDrawStationWaitGrid)
 			{
-				for (auto Pair : QueueFragment->Grids)
+				for (FVector GridPoint : QueueFragment->Grids.SlotPositions)
 				{
-					const FRogueWaitingGrid& GridData = Pair.Value;
-					for (FVector GridPoint : GridData.SlotPositions)
-					{
-						GridPoint.Z += 20.f;
-						DrawDebugSphere(GetWorld(), GridPoint, 5.f, 8, FColor::Black, true, 30.f);
-					}
+					GridPoint.Z += 20.f;
+					DrawDebugSphere(GetWorld(), GridPoint, 5.f, 8, FColor::Black, true, 30.f);
 				}
 			}
 		}
 	}
 }
 
+bool URogueTrainWorldSubsystem::BakeCookedTrack()
+{
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	if (!Settings || !EntityManager) return false;
+
+	USplineComponent* Spline = TrackSpline.Get();
+	if (!Spline || Platforms.Num() == 0 || StationEntities.Num() != Platforms.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Rogue.BakeTrack: stations are not all created yet"));
+		return false;
+	}
+
+	// Waiting grids per station
+	TArray<FRogueWaitingGrids> Grids;
+	Grids.SetNum(Platforms.Num());
+	for (const auto& It : StationEntities)
+	{
+		const auto* QueueFragment = EntityManager->GetFragmentDataPtr<FRogueStationQueueFragment>(It.Value);
+		if (!QueueFragment || !Grids.IsValidIndex(It.Key)) continue;
+
+		Grids[It.Key] = QueueFragment->Grids;
+	}
+
+	const FString Filename = FRogueCookedTrack::GetFilename(*Settings);
+	const bool bSaved = FRogueCookedTrack::Save(Filename, TrackSourceHash, *Spline, Platforms, Grids, GetTrackShared());
+	UE_LOG(LogTemp, Display, TEXT("Rogue.BakeTrack: %s %s"), bSaved ? TEXT("wrote") : TEXT("failed to write"), *Filename);
+	return bSaved;
+}
+
 #endif
@@ -0,0 +1,79 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Utilities/RogueDemandUtility.h"
+#include "Algo/BinarySearch.h"
+
+int32 RogueDemandUtility::SamplePoisson(const FRandomStream& Stream, const float Lambda)
+{
+	if (Lambda <= 0.f) return 0;
+
+	if (Lambda > 30.f)
+	{
+		// Box-Muller normal draw, the Poisson is close to N(Lambda, Lambda) at this size
+		const float U1 = FMath::Max(Stream.GetFraction(), UE_KINDA_SMALL_NUMBER);
+		const float U2 = Stream.GetFraction();
+		const float Normal = FMath::Sqrt(-2.f * FMath::Loge(U1)) * FMath::Cos(UE_TWO_PI * U2);
+		return FMath::Max(0, FMath::RoundToInt32(Lambda + FMath::Sqrt(Lambda) * Normal));
+	}
+
+	// Knuth, multiply uniforms until the product drops below e^-Lambda
+	const float Limit = FMath::Exp(-Lambda);
+	float Product = Stream.GetFraction();
+	int32 Count = 0;
+	while (Product > Limit)
+	{
+		++Count;
+		Product *= Stream.GetFraction();
+	}
+	
+	return Count;
+}
+
+void RogueDemandUtility::SampleArrivals(const FRandomStream& Stream, TConstArrayView<float> Rates, const float Scale, const float Seconds, TArrayView<int32> OutArrivals)
+{
+	check(Rates.Num() == OutArrivals.Num());
+	
+	const float Exposure = Scale * Seconds;
+	for (int32 i = 0; i < Rates.Num(); ++i)
+	{
+		OutArrivals[i] = SamplePoisson(Stream, Rates[i] * Exposure);
+	}
+}
+
+int32 RogueDemandUtility::ShareHeadroom(TArrayView<int32> InOutArrivals, const int32 Headroom, const int32 StartIndex)
+{
+	int64 Total = 0;
+	for (const int32 Count : InOutArrivals) Total += Count;
+	if (Total <= Headroom) return static_cast<int32>(Total);
+
+	const int32 Num = InOutArrivals.Num();
+	const int64 Cap = FMath::Max(0, Headroom);
+	auto ShareOf = [&](const int32 Count) { return static_cast<int32>(Count * Cap / Total); };
+
+	int32 Extra = static_cast<int32>(Cap);
+	for (const int32 Count : InOutArrivals) Extra -= ShareOf(Count);
+
+	// Leftovers from rounding down go one each to the stations that were cut, starting at StartIndex
+	for (int32 k = 0; k < Num; ++k)
+	{
+		const int32 i = (StartIndex + k) % Num;
+		int32 Share = ShareOf(InOutArrivals[i]);
+		if (Extra > 0 && Share < InOutArrivals[i])
+		{
+			++Share;
+			--Extra;
+		}
+		InOutArrivals[i] = Share;
+	}
+
+	return static_cast<int32>(Cap) - Extra;
+}
+
+int32 RogueDemandUtility::SampleCdf(const FRandomStream& Stream, TConstArrayView<float> CdfRow)
+{
+	if (CdfRow.Num() == 0 || CdfRow.Last() <= 0.f) return INDEX_NONE;
+
+	const int32 Idx = Algo::UpperBound(CdfRow, Stream.GetFraction() * CdfRow.Last());
+	return FMath::Min(Idx, CdfRow.Num() - 1);
+}
@@ -8,87 +8,198 @@
 #include "MassMovementFragments.h"
 #include "MassNavigationFragments.h"
 #include "MassRepresentationFragments.h"
+#include "Data/RogueDeveloperSettings.h"
 #include "Subsystems/RogueTrainWorldSubsystem.h"
 
 
-void RoguePassengerQueueUtility::EnqueueAtWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx,
+namespace
+{
+	// True when A boards before B: higher priority, then earlier arrival, then earlier enqueue
+	struct FRogueBoardingOrder
+	{
+		FORCEINLINE bool operator()(const FRoguePassengerQueueEntry& A, const FRoguePassengerQueueEntry& B) const
+		{
+			if (A.Priority != B.Priority) return A.Priority > B.Priority;
+			if (A.EnqueuedGameTime != B.EnqueuedGameTime) return A.EnqueuedGameTime < B.EnqueuedGameTime;
+			return static_cast<int32>(A.Sequence - B.Sequence) < 0;
+		}
+	};
+}
+
+void RoguePassengerQueueUtility::ResetQueues(FRogueStationQueueFragment& StationQueueFragment)
+{
+	StationQueueFragment.QueuesByWaitingPoint.SetNum(StationQueueFragment.Grids.Num());
+	for (int32 Grid = 0; Grid < StationQueueFragment.Grids.Num(); ++Grid)
+	{
+		TArray<FRoguePassengerQueueEntry>& Entries = StationQueueFragment.QueuesByWaitingPoint[Grid];
+		Entries.Reset(StationQueueFragment.Grids.GetNumSlots(Grid));
+	}
+	StationQueueFragment.NextQueueSequence = 0;
+}
+
+void RoguePassengerQueueUtility::EnqueueAtWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, const int32 WaitingSlotIdx,
 	const FMassEntityHandle Passenger, const FMassEntityHandle DestStation, const float Time, const int32 Priority)
 {
-	TArray<FRoguePassengerQueueEntry>* Entries = StationQueueFragment.QueuesByWaitingPoint.Find(WaitingPointIdx);
-	if (!Entries) { Entries = &StationQueueFragment.QueuesByWaitingPoint.Add(WaitingPointIdx); }
+	// Only passengers standing in their own slot can be queued
+	if (!StationQueueFragment.Grids.IsValidSlotIndex(WaitingPointIdx, WaitingSlotIdx)) return;
+	if (StationQueueFragment.Grids.GetOccupant(WaitingPointIdx, WaitingSlotIdx) != Passenger) return;
+
+	// Everyone without priority boards in arrival order from the ready ring
+	if (Priority <= 0)
+	{
+		StationQueueFragment.Grids.PushReady(WaitingPointIdx, WaitingSlotIdx);
+		return;
+	}
+	
+	if (!StationQueueFragment.QueuesByWaitingPoint.IsValidIndex(WaitingPointIdx))
+	{
+		StationQueueFragment.QueuesByWaitingPoint.SetNum(WaitingPointIdx + 1);
+	}
 	
 	FRoguePassengerQueueEntry QueueEntry;
 	QueueEntry.Passenger = Passenger;
 	QueueEntry.DestStation = DestStation;
 	QueueEntry.WaitingPointIdx = WaitingPointIdx;
+	QueueEntry.WaitingSlotIdx = WaitingSlotIdx;
 	QueueEntry.EnqueuedGameTime = Time;
 	QueueEntry.Priority = Priority;
+	QueueEntry.Sequence = StationQueueFragment.NextQueueSequence++;
 	
-	Entries->Add(MoveTemp(QueueEntry));
+	StationQueueFragment.QueuesByWaitingPoint[WaitingPointIdx].HeapPush(MoveTemp(QueueEntry), FRogueBoardingOrder());
+}
+
+const FRoguePassengerQueueEntry* RoguePassengerQueueUtility::PeekWaitingPoint(const FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx)
+{
+	if (!StationQueueFragment.QueuesByWaitingPoint.IsValidIndex(WaitingPointIdx)) return nullptr;
+
+	const TArray<FRoguePassengerQueueEntry>& Entries = StationQueueFragment.QueuesByWaitingPoint[WaitingPointIdx];
+	return Entries.Num() > 0 ? &Entries.HeapTop() : nullptr;
 }
 
 bool RoguePassengerQueueUtility::DequeueFromWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, FRoguePassengerQueueEntry& Out)
 {
-	TArray<FRoguePassengerQueueEntry>* Entries = StationQueueFragment.QueuesByWaitingPoint.Find(WaitingPointIdx);
-	if (!Entries || Entries->Num() == 0) return false;
+	if (!StationQueueFragment.QueuesByWaitingPoint.IsValidIndex(WaitingPointIdx)) return false;
+	
+	TArray<FRoguePassengerQueueEntry>& Entries = StationQueueFragment.QueuesByWaitingPoint[WaitingPointIdx];
+	if (Entries.Num() == 0) return false;
 
-	int32 BestIdx = INDEX_NONE;
-	int32 BestPriority = TNumericLimits<int32>::Min();
-	float BestTime = 0.f;
+	Entries.HeapPop(Out, FRogueBoardingOrder(), EAllowShrinking::No);
+	return true;
+}
 
-	for (int32 i = 0; i < Entries->Num(); ++i)
-	{
-		const auto& QueueEntry = (*Entries)[i];
+bool RoguePassengerQueueUtility::RemoveFromWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, const FMassEntityHandle Passenger)
+{
+	if (!StationQueueFragment.QueuesByWaitingPoint.IsValidIndex(WaitingPointIdx)) return false;
 
-		if (BestIdx == INDEX_NONE || QueueEntry.Priority > BestPriority || (QueueEntry.Priority == BestPriority && QueueEntry.EnqueuedGameTime < BestTime))
-		{
-			BestIdx = i;
-			BestPriority = QueueEntry.Priority;
-			BestTime = QueueEntry.EnqueuedGameTime;
-		}
-	}
+	// Priority passengers are few, a scan to find the entry is cheaper than keeping an index per slot
+	TArray<FRoguePassengerQueueEntry>& Entries = StationQueueFragment.QueuesByWaitingPoint[WaitingPointIdx];
+	const int32 Index = Entries.IndexOfByPredicate([Passenger](const FRoguePassengerQueueEntry& Entry) { return Entry.Passenger == Passenger; });
+	if (Index == INDEX_NONE) return false;
+
+	Entries.HeapRemoveAt(Index, FRogueBoardingOrder(), EAllowShrinking::No);
+	return true;
+}
+
+bool RoguePassengerUtility::Disembark(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment, const FMassEntityHandle Station,
+	const FVector& Location)
+{
+	// Only the riders for this station are touched
+	FRogueOccupantBucket* Bucket = CarriageFragment.FindOccupantBucket(Station);
+	if (!Bucket) return false;
 
-	if (BestIdx != INDEX_NONE)
+	while (Bucket->Passengers.Num() > 0)
 	{
-		Out = (*Entries)[BestIdx];
-		Entries->RemoveAtSwap(BestIdx, 1, EAllowShrinking::No);
+		const FMassEntityHandle Passenger = Bucket->Passengers.Pop(EAllowShrinking::No);
+		--CarriageFragment.NumOccupants;
+
+		// Entities gone while riding are dropped
+		FRoguePassengerFragment* PassengerFragment = IsHandleValid(EntityManager, Passenger) ? EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger) : nullptr;
+		if (!PassengerFragment) continue;
+		
+		RoguePassengerUtility::ShowPassenger(EntityManager, Passenger, Location);
+		PassengerFragment->VehicleHandle = FMassEntityHandle();
+		PassengerFragment->WaitingPointIdx = INDEX_NONE; 
+		PassengerFragment->Phase = ERoguePassengerPhase::UnloadAtStation;
+		Context.Defer().PushCommand<FMassCommandRemoveTag<FRoguePassengerRidingTag>>(Passenger);
 		return true;
 	}
 	
 	return false;
 }
 
-void RoguePassengerUtility::Disembark(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment, const int32 Index, const FVector& Location)
+bool RoguePassengerUtility::TryBoard(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, const FMassEntityHandle Passenger, const FMassEntityHandle CarriageEntity, FRogueCarriageFragment& CarriageFragment)
 {
-	const FMassEntityHandle Passenger = CarriageFragment.Occupants[Index];
-	if (IsHandleValid(EntityManager, Passenger))
+	if (CarriageFragment.GetNumRiders() >= CarriageFragment.Capacity) return false;
+	if (!IsHandleValid(EntityManager, Passenger)) return false;
+
+	// attach
+	FRoguePassengerFragment* PassengerFragment = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger);
+	if (!PassengerFragment) return false;
+	
+	PassengerFragment->VehicleHandle = CarriageEntity;
+	PassengerFragment->Phase = ERoguePassengerPhase::ToAssignedCarriage;
+
+	CarriageFragment.AddOccupant(Passenger, PassengerFragment->DestinationStation);
+	
+	return true;
+}
+
+void RoguePassengerUtility::VirtualizeRider(URogueTrainWorldSubsystem& TrainSubsystem, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment,
+	const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation, const int32 RouteIndex)
+{
+	CarriageFragment.RemoveOccupant(Passenger, DestinationStation);
+
+	FRogueRiderCount* Riders = CarriageFragment.VirtualRiders.FindByPredicate([&](const FRogueRiderCount& Entry)
 	{
-		if (FRoguePassengerFragment* PassengerFragment = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger))
-		{
-			RoguePassengerUtility::ShowPassenger(EntityManager, Passenger, Location);
-			PassengerFragment->VehicleHandle = FMassEntityHandle();
-			PassengerFragment->WaitingPointIdx = INDEX_NONE; 
-			PassengerFragment->Phase = ERoguePassengerPhase::UnloadAtStation;
-		}
+		return Entry.DestinationStation == DestinationStation && Entry.RouteIndex == RouteIndex;
+	});
+	if (!Riders)
+	{
+		Riders = &CarriageFragment.VirtualRiders.AddDefaulted_GetRef();
+		Riders->DestinationStation = DestinationStation;
+		Riders->RouteIndex = RouteIndex;
 	}
-	
-	CarriageFragment.Occupants.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	++Riders->Count;
+	++CarriageFragment.NumVirtualRiders;
+	TrainSubsystem.AddVirtualRiders(1);
+
+	// Only the destination and final station matter from here, the entity goes back to the pool
+	TrainSubsystem.EnqueueEntityToPool(Passenger, Context, ERogueEntityType::Passenger);
 }
 
-bool RoguePassengerUtility::TryBoard(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, const FMassEntityHandle Passenger, const FMassEntityHandle CarriageEntity, FRogueCarriageFragment& CarriageFragment)
+bool RoguePassengerUtility::MaterializeRider(URogueTrainWorldSubsystem& TrainSubsystem, FRogueCarriageFragment& CarriageFragment, const FMassEntityHandle Station, const FVector& Location)
 {
-	if (CarriageFragment.Occupants.Num() >= CarriageFragment.Capacity) return false;
-	if (!IsHandleValid(EntityManager, Passenger)) return false;
+	if (CarriageFragment.NumVirtualRiders <= 0) return false;
 
-	// attach
-	if (FRoguePassengerFragment* PassengerFragment = EntityManager.GetFragmentDataPtr<FRoguePassengerFragment>(Passenger))
+	const int32 EntryIdx = CarriageFragment.VirtualRiders.IndexOfByPredicate([&](const FRogueRiderCount& Entry) { return Entry.DestinationStation == Station; });
+	if (EntryIdx == INDEX_NONE) return false;
+
+	const auto* Settings = GetDefault<URogueDeveloperSettings>();
+	const FMassEntityTemplate* PassengerTemplate = TrainSubsystem.GetPassengerTemplate();
+	if (!Settings || !PassengerTemplate || !PassengerTemplate->IsValid()) return false;
+
+	const int32 RouteIndex = CarriageFragment.VirtualRiders[EntryIdx].RouteIndex;
+	if (--CarriageFragment.VirtualRiders[EntryIdx].Count <= 0)
 	{
-		PassengerFragment->VehicleHandle = CarriageEntity;
-		PassengerFragment->Phase = ERoguePassengerPhase::ToAssignedCarriage;
+		CarriageFragment.VirtualRiders.RemoveAtSwap(EntryIdx, 1, EAllowShrinking::No);
 	}
+	--CarriageFragment.NumVirtualRiders;
+	TrainSubsystem.AddVirtualRiders(-1);
 
-	CarriageFragment.Occupants.Add(Passenger);
-	
+	// Fresh passenger at the carriage, picking up where Disembark leaves an entity rider
+	FRogueSpawnRequest Request;
+	Request.Type = ERogueEntityType::Passenger;
+	Request.EntityTemplate = PassengerTemplate;
+	Request.RemainingCount = 1;
+	Request.Transform = FTransform(Location);
+	Request.InitialPhase = ERoguePassengerPhase::UnloadAtStation;
+	Request.OriginStation = Station;
+	Request.DestinationStation = Station;
+	Request.RouteIndex = RouteIndex;
+	Request.AcceptanceRadius = Settings->PassengerAcceptanceRadius;
+	Request.MaxSpeed = Settings->PassengerMaxSpeed;
+
+	TrainSubsystem.EnqueueSpawns(Request);
 	return true;
 }
 
@@ -144,24 +255,6 @@ void RoguePassengerUtility::ShowPassenger(const FMassEntityManager& EntityManage
 	}
 }
 
-int32 RoguePassengerUtility::FindNearestIndex(const TArray<FVector>& Points, const FVector& From)
-{
-	int32 Best = INDEX_NONE;
-	float BestDistSq = TNumericLimits<float>::Max();
-	
-	for (int32 i = 0; i < Points.Num(); ++i)
-	{
-		const float DistSq = FVector::DistSquared(Points[i], From);
-		if (DistSq < BestDistSq)
-		{
-			BestDistSq = DistSq;
-			Best = i;
-		}
-	}
-	
-	return Best;
-}
-
 bool RoguePassengerUtility::SnapToPlatform(const UWorld* WorldContext, FVector& InOutPos, const float MaxStepUp, const float MaxDrop)
 {
 	const FVector Start = InOutPos + FVector(0,0, MaxStepUp);
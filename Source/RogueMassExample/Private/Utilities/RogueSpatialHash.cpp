@@ -0,0 +1,45 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Utilities/RogueSpatialHash.h"
+#include "Async/ParallelFor.h"
+
+void FRogueSpatialHash::Build(TConstArrayView<FVector> Positions, TConstArrayView<int32> Scopes, const float InCellSize)
+{
+	check(Positions.Num() == Scopes.Num());
+	
+	const int32 NumItems = Positions.Num();
+	InvCellSize = 1.f / FMath::Max(InCellSize, 1.f);
+
+	// Roughly two buckets per item keeps collisions low without clearing a huge table every frame
+	NumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(NumItems * 2, 64));
+	BucketStarts.Init(0, NumBuckets + 1);
+	Items.SetNumUninitialized(NumItems);
+	ItemScopes.SetNumUninitialized(NumItems);
+	ItemBuckets.SetNumUninitialized(NumItems);
+
+	ParallelFor(NumItems, [&](const int32 i)
+	{
+		const int32 CellX = FMath::FloorToInt32(Positions[i].X * InvCellSize);
+		const int32 CellY = FMath::FloorToInt32(Positions[i].Y * InvCellSize);
+		ItemBuckets[i] = GetBucket(Scopes[i], CellX, CellY);
+	});
+
+	// Counting sort into the flat item array
+	for (const int32 Bucket : ItemBuckets)
+	{
+		++BucketStarts[Bucket + 1];
+	}
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		BucketStarts[Bucket + 1] += BucketStarts[Bucket];
+	}
+
+	BucketCursors = BucketStarts;
+	for (int32 i = 0; i < NumItems; ++i)
+	{
+		const int32 Slot = BucketCursors[ItemBuckets[i]]++;
+		Items[Slot] = i;
+		ItemScopes[Slot] = Scopes[i];
+	}
+}
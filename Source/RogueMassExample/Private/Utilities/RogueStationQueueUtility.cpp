@@ -3,17 +3,155 @@
 
 #include "Utilities/RogueStationQueueUtility.h"
 #include "MassEntityManager.h"
+#include "Engine/World.h"
+#include "Utilities/RoguePassengerUtility.h"
 
 
+void RogueStationQueueUtility::BuildPlatformHeightField(const UWorld* WorldContext, const FRoguePlatformData& StationSegment, FRogueStationQueueFragment& QueueFragment,
+	const float CellSize)
+{
+	FRoguePlatformHeightField& Field = QueueFragment.PlatformHeights;
+	Field = FRoguePlatformHeightField();
+	if (!WorldContext || CellSize <= 0.f) return;
+
+	// Cover the platform length and every point passengers walk to across it, with a cell of margin
+	const float HalfLength = 0.5f * StationSegment.PlatformLength;
+	float MinY = 0.f;
+	float MaxY = 0.f;
+	auto Extend = [&](const FVector& Point)
+	{
+		const float Y = FVector::DotProduct(Point - StationSegment.Center, StationSegment.Right);
+		MinY = FMath::Min(MinY, Y);
+		MaxY = FMath::Max(MaxY, Y);
+	};
+	for (const FVector& Point : QueueFragment.WaitingPoints) Extend(Point);
+	for (const FVector& Point : QueueFragment.SpawnPoints) Extend(Point);
+	for (const FVector& Point : QueueFragment.Grids.SlotPositions) Extend(Point);
+
+	Field.AxisX = StationSegment.Fwd;
+	Field.AxisY = StationSegment.Right;
+	Field.Origin = StationSegment.Center - Field.AxisX * (HalfLength + CellSize) + Field.AxisY * (MinY - CellSize);
+	Field.InvCellSize = 1.f / CellSize;
+	Field.NumX = FMath::CeilToInt32((StationSegment.PlatformLength + 2.f * CellSize) / CellSize) + 1;
+	Field.NumY = FMath::CeilToInt32((MaxY - MinY + 2.f * CellSize) / CellSize) + 1;
+	Field.Heights.Init(MAX_flt, Field.NumX * Field.NumY);
+
+	// Same vertical window as RoguePassengerUtility::SnapToPlatform, measured from the platform center height
+	constexpr float MaxStepUp = 60.f;
+	constexpr float MaxDrop = 200.f;
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(BuildPlatformHeightField), /*bTraceComplex*/ false);
+	Params.bReturnPhysicalMaterial = false;
+
+	for (int32 Y = 0; Y < Field.NumY; ++Y)
+	{
+		for (int32 X = 0; X < Field.NumX; ++X)
+		{
+			FVector Point = Field.Origin + Field.AxisX * (X * CellSize) + Field.AxisY * (Y * CellSize);
+			Point.Z = StationSegment.Center.Z;
+
+			FHitResult Hit;
+			if (WorldContext->LineTraceSingleByChannel(Hit, Point + FVector(0, 0, MaxStepUp), Point - FVector(0, 0, MaxDrop), ECC_Visibility, Params) && Hit.bBlockingHit)
+			{
+				Field.Heights[Y * Field.NumX + X] = Hit.ImpactPoint.Z;
+			}
+		}
+	}
+}
+
+void RogueStationQueueUtility::BuildPlatformFlowFields(FRogueStationQueueFragment& QueueFragment)
+{
+	FRoguePlatformFlowFields& Flow = QueueFragment.FlowFields;
+	Flow = FRoguePlatformFlowFields();
+	
+	const FRoguePlatformHeightField& Grid = QueueFragment.PlatformHeights;
+	if (!Grid.IsValid()) return;
+
+	const int32 NumX = Grid.NumX;
+	const int32 NumY = Grid.NumY;
+	Flow.NumCells = NumX * NumY;
+	Flow.NumFields = QueueFragment.WaitingPoints.Num() + 1;
+	Flow.Directions.Init(FRoguePlatformFlowFields::NoDirection, Flow.NumFields * Flow.NumCells);
+
+	// Cells the height trace missed are not walkable
+	auto IsWalkable = [&](const int32 X, const int32 Y)
+	{
+		return X >= 0 && Y >= 0 && X < NumX && Y < NumY && Grid.Heights[Y * NumX + X] != MAX_flt;
+	};
+	auto ToCell = [&](const FVector& Point)
+	{
+		const FVector Local = Point - Grid.Origin;
+		const int32 X = FMath::RoundToInt32(FVector::DotProduct(Local, Grid.AxisX) * Grid.InvCellSize);
+		const int32 Y = FMath::RoundToInt32(FVector::DotProduct(Local, Grid.AxisY) * Grid.InvCellSize);
+		return (X >= 0 && Y >= 0 && X < NumX && Y < NumY) ? Y * NumX + X : INDEX_NONE;
+	};
+
+	TArray<int32> Frontier;
+	TBitArray<> Visited;
+	auto BuildField = [&](const int32 Field, TConstArrayView<FVector> Goals)
+	{
+		uint8* Directions = Flow.Directions.GetData() + Field * Flow.NumCells;
+		Frontier.Reset();
+		Visited.Init(false, Flow.NumCells);
+
+		// Multi source, goal cells keep NoDirection so passengers steer straight once inside
+		for (const FVector& Goal : Goals)
+		{
+			const int32 Cell = ToCell(Goal);
+			if (Cell == INDEX_NONE || Visited[Cell]) continue;
+			Visited[Cell] = true;
+			Frontier.Add(Cell);
+		}
+
+		for (int32 Head = 0; Head < Frontier.Num(); ++Head)
+		{
+			const int32 CellX = Frontier[Head] % NumX;
+			const int32 CellY = Frontier[Head] / NumX;
+
+			for (int32 Code = 0; Code < 8; ++Code)
+			{
+				const int32 X = CellX + FRoguePlatformFlowFields::OffsetX[Code];
+				const int32 Y = CellY + FRoguePlatformFlowFields::OffsetY[Code];
+				if (!IsWalkable(X, Y) || Visited[Y * NumX + X]) continue;
+
+				// Diagonals must not cut past a missed cell
+				if (X != CellX && Y != CellY && (!IsWalkable(X, CellY) || !IsWalkable(CellX, Y))) continue;
+
+				// Point back at the cell we came from
+				Visited[Y * NumX + X] = true;
+				Directions[Y * NumX + X] = static_cast<uint8>((Code + 4) & 7);
+				Frontier.Add(Y * NumX + X);
+			}
+		}
+	};
+
+	TArray<FVector> Goals;
+	for (int32 WaitIdx = 0; WaitIdx < QueueFragment.WaitingPoints.Num(); ++WaitIdx)
+	{
+		// The whole waiting grid is the goal, the last stretch to a slot is a straight line
+		Goals.Reset();
+		Goals.Add(QueueFragment.WaitingPoints[WaitIdx]);
+		Goals.Append(QueueFragment.Grids.GetSlotPositions(WaitIdx));
+		BuildField(WaitIdx, Goals);
+	}
+	BuildField(Flow.GetExitField(), QueueFragment.SpawnPoints);
+}
+
 void RogueStationQueueUtility::BuildGridForWaitingPoint(const FRoguePlatformData& StationSegment, FRogueStationQueueFragment& QueueFragment,
                                                         const FVector& WaitingCenter, const int32 WaitingPointIdx)
 {
-	FRogueWaitingGrid& Grid = QueueFragment.Grids.FindOrAdd(WaitingPointIdx);
-	Grid.SlotPositions.Reset();
-	Grid.OccupiedBy.Reset();
+	// Grids are stored flat in waiting point order
+	if (!ensure(WaitingPointIdx == QueueFragment.Grids.Num())) return;
+	TArray<FVector, TInlineAllocator<FRogueWaitingGrids::MaxSlotsPerGrid>> SlotPositions;
 
-	const int32 Cols = FMath::Max(1, QueueFragment.WaitingGridConfig.GridCols);
-	const int32 Rows = FMath::Max(1, QueueFragment.WaitingGridConfig.GridRows);
+	const int32 Cols = FMath::Clamp(QueueFragment.WaitingGridConfig.GridCols, 1, FRogueWaitingGrids::MaxSlotsPerGrid);
+	int32 Rows = FMath::Max(1, QueueFragment.WaitingGridConfig.GridRows);
+	if (Cols * Rows > FRogueWaitingGrids::MaxSlotsPerGrid)
+	{
+		const int32 KeptRows = FRogueWaitingGrids::MaxSlotsPerGrid / Cols;
+		UE_LOG(LogTemp, Warning, TEXT("Waiting grid %d x %d at waiting point %d is over %d slots, keeping %d rows"),
+			Cols, Rows, WaitingPointIdx, FRogueWaitingGrids::MaxSlotsPerGrid, KeptRows);
+		Rows = KeptRows;
+	}
 	const float ColumnHalfWidth = 0.5f * (Cols - 1);
 	const float RowHalfWidth = 0.5f * (Rows - 1);
 	const float MaxHalfWidth = 0.5f * StationSegment.PlatformLength - StationSegment.WaitingGridConfig.GridEdgeInset;
@@ -29,61 +167,35 @@ void RogueStationQueueUtility::BuildGridForWaitingPoint(const FRoguePlatformData
 			const float ClampedLength = FMath::Clamp(Length, -MaxHalfWidth, MaxHalfWidth);
 			const FVector PointAdjusted = GridCenter + StationSegment.Fwd * ClampedLength + StationSegment.Right * (Width + 20.f);
 
-			Grid.SlotPositions.Add(PointAdjusted);
+			SlotPositions.Add(PointAdjusted);
 		}
 	}
 
-	Grid.OccupiedBy.Init(FMassEntityHandle(), Grid.SlotPositions.Num());
+	QueueFragment.Grids.AddGrid(SlotPositions);
 }
 
 int32 RogueStationQueueUtility::ClaimWaitingSlot(FRogueStationQueueFragment* QueueFragment, const int32 WaitingPointIdx, const FMassEntityHandle& Passenger, FVector& OutSlotPos)
 {
-	FRogueWaitingGrid* Grid = QueueFragment->Grids.Find(WaitingPointIdx);
-	if (!Grid) return INDEX_NONE;
-
-	int32 SlotIdx = INDEX_NONE;
-	int32 CheckCount = Grid->OccupiedBy.Num();
-	while (SlotIdx == INDEX_NONE)
-	{
-		const int32 TestIdx = (Grid->OccupiedBy.Num() > 0) ? FMath::RandRange(0, Grid->OccupiedBy.Num() - 1) : INDEX_NONE;
-		if (TestIdx != INDEX_NONE)
-		{
-			// Check slot is free
-			if (!Grid->OccupiedBy[TestIdx].IsValid())
-			{
-				SlotIdx = TestIdx;
-				Grid->OccupiedBy[SlotIdx] = Passenger;
-				OutSlotPos = Grid->SlotPositions[SlotIdx];
-				return SlotIdx;
-			}
-		}
-
-		CheckCount--;
-		if (CheckCount <= 0) break;
-	}
+	if (!QueueFragment) return INDEX_NONE;
 	
-	// Fallback: first available
-	for (int32 i = 0; i < Grid->OccupiedBy.Num(); ++i)
-	{
-		if (!Grid->OccupiedBy[i].IsValid())
-		{
-			Grid->OccupiedBy[i] = Passenger;
-			OutSlotPos = Grid->SlotPositions[i];
-			return i;
-		}
-	}
-	return INDEX_NONE;
+	const int32 SlotIdx = QueueFragment->Grids.Claim(WaitingPointIdx, Passenger);
+	if (SlotIdx == INDEX_NONE) return INDEX_NONE;
+	
+	OutSlotPos = QueueFragment->Grids.GetSlotPosition(WaitingPointIdx, SlotIdx);
+	return SlotIdx;
 }
 
 void RogueStationQueueUtility::ReleaseSlot(FRogueStationQueueFragment& QueueFragment, const FRoguePassengerFragment& PassengerFragment)
 {
-	if (FRogueWaitingGrid* Grid = QueueFragment.Grids.Find(PassengerFragment.WaitingPointIdx))
-	{
-		if (Grid->IsValidSlotIndex(PassengerFragment.WaitingSlotIdx))
-		{
-			Grid->OccupiedBy[PassengerFragment.WaitingSlotIdx] = FMassEntityHandle();
-		}
-	}
+	ReleaseWaitingSlot(QueueFragment, PassengerFragment.WaitingPointIdx, PassengerFragment.WaitingSlotIdx);
+}
+
+void RogueStationQueueUtility::ReleaseWaitingSlot(FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx, const int32 SlotIdx)
+{
+	if (!QueueFragment.Grids.IsValidSlotIndex(WaitPointIdx, SlotIdx)) return;
+
+	RoguePassengerQueueUtility::RemoveFromWaitingPoint(QueueFragment, WaitPointIdx, QueueFragment.Grids.GetOccupant(WaitPointIdx, SlotIdx));
+	QueueFragment.Grids.Release(WaitPointIdx, SlotIdx);
 }
 
 /*bool RogueStationQueueUtility::DequeueFromGrid(const FMassEntityManager& EntityManger, FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx,
@@ -115,29 +227,16 @@ void RogueStationQueueUtility::ReleaseSlot(FRogueStationQueueFragment& QueueFrag
 	return false;
 }*/
 
-bool RogueStationQueueUtility::PeekFromGrid(const FMassEntityManager& EntityManger, FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx,
-	FMassEntityHandle& OutPassenger, const FMassEntityHandle CurrentStationEntity, int32& OutSlotIdx, FVector& OutSlotPos)
+bool RogueStationQueueUtility::PeekFromGrid(const FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx, FMassEntityHandle& OutPassenger,
+	int32& OutSlotIdx, FVector& OutSlotPos)
 {
-	FRogueWaitingGrid* Grid = QueueFragment.Grids.Find(WaitPointIdx);
-	if (!Grid) return false;
-
-	// Prefer an actually occupied slot; scan once (grids are small).
-	for (int32 i = 0; i < Grid->OccupiedBy.Num(); ++i)
-	{
-		if (Grid->OccupiedBy[i].IsValid())
-		{
-			if (const auto PassengerFragment = EntityManger.GetFragmentDataPtr<FRoguePassengerFragment>(Grid->OccupiedBy[i]))
-			{
-				if (!PassengerFragment->bWaiting || PassengerFragment->OriginStation != CurrentStationEntity) continue;
-				
-				OutPassenger = Grid->OccupiedBy[i];
-				OutSlotIdx = i;
-				OutSlotPos = Grid->SlotPositions.IsValidIndex(i) ? Grid->SlotPositions[i] : FVector::ZeroVector;
-				return true;
-			}
-			
-		}
-	}
-	
-	return false;
+	// Priority heap first, then the ready ring front. Only passengers that reached their slot at this station are in either
+	const FRoguePassengerQueueEntry* Priority = RoguePassengerQueueUtility::PeekWaitingPoint(QueueFragment, WaitPointIdx);
+	const int32 SlotIdx = Priority ? Priority->WaitingSlotIdx : QueueFragment.Grids.PeekReady(WaitPointIdx);
+	if (!QueueFragment.Grids.IsValidSlotIndex(WaitPointIdx, SlotIdx)) return false;
+
+	OutPassenger = QueueFragment.Grids.GetOccupant(WaitPointIdx, SlotIdx);
+	OutSlotIdx = SlotIdx;
+	OutSlotPos = QueueFragment.Grids.GetSlotPosition(WaitPointIdx, SlotIdx);
+	return true;
 }
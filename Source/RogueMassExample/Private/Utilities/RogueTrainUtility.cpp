@@ -2,29 +2,24 @@
 
 
 #include "Utilities/RogueTrainUtility.h"
+#include "Algo/BinarySearch.h"
 #include "Components/SplineComponent.h"
 #include "Data/RogueDeveloperSettings.h"
 
 using namespace RogueTrainUtility;
 
-int32 RogueTrainUtility::FindNextStation(const USplineComponent& Spline,const TArray<FRoguePlatformData>& Platforms, const float CurrentAlpha)
+int32 RogueTrainUtility::FindNextStation(const FRogueTrackSharedFragment& Track, const double CurrentDistance)
 {
-	int32 BestIdx = INDEX_NONE;
-	float BestArc = FLT_MAX;
+	const TArray<double>& Docks = Track.SortedDockDistances;
+	if (Docks.Num() == 0) return INDEX_NONE;
 
-	for (int32 i = 0; i < Platforms.Num(); ++i)
-	{
-		const FVector Ref = Platforms[i].Center; 
-		const float StationAlpha = AlphaAtWorld(Spline, Ref);
-
-		const float Arc = ArcDistanceWrapped(CurrentAlpha, StationAlpha);
-		if (Arc > KINDA_SMALL_NUMBER && Arc < BestArc) 
-		{
-			BestArc = Arc;
-			BestIdx = i;
-		}
-	}
-	return BestIdx; 
+	// Docks sitting right on the current position count as behind us, a fixed margin so it doesn't grow with the line
+	constexpr double DockEpsilonCm = 1.0;
+	const double Distance = WrapTrackDistance(CurrentDistance, Track.TrackLength) + DockEpsilonCm;
+	const int32 Idx = Algo::UpperBound(Docks, Distance);
+
+	// Past the last dock, wrap to the first one
+	return Track.SortedDockStations[Docks.IsValidIndex(Idx) ? Idx : 0];
 }
 
 float RogueTrainUtility::AlphaAtWorld(const USplineComponent& Spline, const FVector& WorldPos)
@@ -42,22 +37,36 @@ float RogueTrainUtility::ArcDistanceWrapped(const float FromAlpha, const float T
 	return d; 
 }
 
-bool RogueTrainUtility::GetSplineSample(const FRogueTrackSharedFragment& Track, const float StationTrackAlpha,
+bool RogueTrainUtility::GetSplineSample(const FRogueTrackSharedFragment& Track, const double Distance,
 	const float AlongOffsetCm, const float LateralOffsetCm, const float VerticalOffsetCm, FSplineStationSample& Out)
 {
+	const double Len = FMath::Max(1.0, Track.TrackLength);
+	const double Dist = WrapTrackDistance(Distance + AlongOffsetCm, Len);
+
+	// Prefer the baked table, falls back to the spline if it has not been built
+	FRogueTrackSample TrackSample;
+	if (SampleTrackTable(Track, Dist, TrackSample))
+	{
+		const FVector SampleLocation = TrackSample.Location + TrackSample.Right * LateralOffsetCm + TrackSample.Up * VerticalOffsetCm;
+
+		Out.Distance = Dist;
+		Out.Alpha = static_cast<float>(Dist / Len);
+		Out.Location = SampleLocation;
+		Out.Forward = TrackSample.Forward;
+		Out.Right = TrackSample.Right;
+		Out.Up = TrackSample.Up;
+		Out.World = FTransform(TrackSample.Rotation, SampleLocation, FVector::OneVector);
+		return true;
+	}
+
 	const USplineComponent* Spline = Track.Spline.Get();
 	if (!Spline) return false;
 
-	const float Len = FMath::Max(1.f, Track.TrackLength);
-	const float RawDist = StationTrackAlpha * Len + AlongOffsetCm;
-	float Dist = FMath::Fmod(RawDist, Len); 
-	if (Dist < 0.f) Dist += Len; 
-
 	// Grab full transform at distance (world space)
-	const FTransform SplineTransform = Spline->GetTransformAtDistanceAlongSpline(Dist, ESplineCoordinateSpace::World);
+	const FTransform SplineTransform = Spline->GetTransformAtDistanceAlongSpline(static_cast<float>(Dist), ESplineCoordinateSpace::World);
 
 	Out.Distance = Dist;
-	Out.Alpha = (Len > 0.f) ? (Dist / Len) : 0.f;
+	Out.Alpha = static_cast<float>(Dist / Len);
 
 	// Basis
 	const FQuat SplineQuat = SplineTransform.GetRotation();
@@ -79,6 +88,123 @@ bool RogueTrainUtility::GetSplineSample(const FRogueTrackSharedFragment& Track,
 	return true;
 }
 
+void RogueTrainUtility::BuildTrackSamples(const USplineComponent& Spline, const float Step, TArray<FRogueTrackSample>& Out, double& OutStep)
+{
+	Out.Reset();
+	OutStep = 0.0;
+
+	const double Len = Spline.GetSplineLength();
+	if (Len <= 0.0 || Step <= 0.f) return;
+
+	// Snap the step so the last sample lands on the spline length, lookups never need to wrap
+	const int32 NumSteps = FMath::Max(1, FMath::CeilToInt32(Len / Step));
+	OutStep = Len / NumSteps;
+	Out.SetNumUninitialized(NumSteps + 1);
+
+	for (int32 i = 0; i <= NumSteps; ++i)
+	{
+		const float Dist = static_cast<float>(FMath::Min(i * OutStep, Len));
+		const FTransform SplineTransform = Spline.GetTransformAtDistanceAlongSpline(Dist, ESplineCoordinateSpace::World);
+		const FQuat SplineQuat = SplineTransform.GetRotation();
+
+		FRogueTrackSample& Sample = Out[i];
+		Sample.Location = SplineTransform.GetLocation();
+		Sample.Forward = SplineQuat.GetForwardVector().GetSafeNormal();
+		Sample.Right = SplineQuat.GetRightVector().GetSafeNormal();
+		Sample.Up = SplineQuat.GetUpVector().GetSafeNormal();
+		Sample.Rotation = SplineQuat;
+		Sample.Heading = FRotationMatrix::MakeFromXZ(Sample.Forward, FVector::UpVector).ToQuat();
+	}
+}
+
+bool RogueTrainUtility::SampleTrackTable(const FRogueTrackSharedFragment& Track, const double Distance, FRogueTrackSample& Out)
+{
+	if (!Track.HasSamples()) return false;
+
+	const double Len = FMath::Max(1.0, Track.TrackLength);
+	const double Scaled = WrapTrackDistance(Distance, Len) * Track.InvSampleStep;
+	const int32 Idx = FMath::Clamp(FMath::FloorToInt32(Scaled), 0, Track.Samples.Num() - 2);
+	const float T = FMath::Clamp(static_cast<float>(Scaled - Idx), 0.f, 1.f);
+
+	const FRogueTrackSample& A = Track.Samples[Idx];
+	const FRogueTrackSample& B = Track.Samples[Idx + 1];
+
+	Out.Location = FMath::Lerp(A.Location, B.Location, T);
+	Out.Forward = FMath::Lerp(A.Forward, B.Forward, T).GetSafeNormal();
+	Out.Right = FMath::Lerp(A.Right, B.Right, T).GetSafeNormal();
+	Out.Up = FMath::Lerp(A.Up, B.Up, T).GetSafeNormal();
+	Out.Rotation = FQuat::FastLerp(A.Rotation, B.Rotation, T).GetNormalized();
+	
+	return true;
+}
+
+bool RogueTrainUtility::SampleTrackBatch(const FRogueTrackSharedFragment& Track, TConstArrayView<double> Distances, const float VerticalOffsetCm,
+	TArrayView<FVector> OutLocations, TArrayView<FVector> OutForwards, TArrayView<FQuat> OutRotations)
+{
+	if (!Track.HasSamples()) return false;
+
+	const int32 Num = Distances.Num();
+	if (OutLocations.Num() < Num || OutForwards.Num() < Num || OutRotations.Num() < Num) return false;
+
+	const double Len = FMath::Max(1.0, Track.TrackLength);
+	const double InvStep = Track.InvSampleStep;
+	const int32 LastSegment = Track.Samples.Num() - 2;
+	const FRogueTrackSample* RESTRICT Samples = Track.Samples.GetData();
+	const VectorRegister4Double VerticalOffset = VectorSetFloat1(static_cast<double>(VerticalOffsetCm));
+
+	for (int32 i = 0; i < Num; ++i)
+	{
+		// Index and fraction stay in double, at 100 km a float distance is already off by centimeters
+		const double Scaled = WrapTrackDistance(Distances[i], Len) * InvStep;
+		const int32 Idx = FMath::Clamp(FMath::FloorToInt32(Scaled), 0, LastSegment);
+		const VectorRegister4Double T = VectorSetFloat1(FMath::Clamp(Scaled - Idx, 0.0, 1.0));
+
+		const FRogueTrackSample& A = Samples[Idx];
+		const FRogueTrackSample& B = Samples[Idx + 1];
+
+		// Lerp(A, B, T) = A + (B - A) * T
+		const VectorRegister4Double LocA = VectorLoadFloat3_W0(&A.Location.X);
+		const VectorRegister4Double FwdA = VectorLoadFloat3_W0(&A.Forward.X);
+		const VectorRegister4Double UpA = VectorLoadFloat3_W0(&A.Up.X);
+		const VectorRegister4Double Loc = VectorMultiplyAdd(VectorSubtract(VectorLoadFloat3_W0(&B.Location.X), LocA), T, LocA);
+		const VectorRegister4Double Up = VectorMultiplyAdd(VectorSubtract(VectorLoadFloat3_W0(&B.Up.X), UpA), T, UpA);
+		const VectorRegister4Double Fwd = VectorMultiplyAdd(VectorSubtract(VectorLoadFloat3_W0(&B.Forward.X), FwdA), T, FwdA);
+
+		// Up is only used for the small ride height offset, a lerped (unnormalized) up is accurate enough
+		VectorStoreFloat3(VectorMultiplyAdd(Up, VerticalOffset, Loc), &OutLocations[i].X);
+		VectorStoreFloat3(VectorMultiply(Fwd, VectorReciprocalSqrtAccurate(VectorDot3(Fwd, Fwd))), &OutForwards[i].X);
+
+		// Shortest path nlerp between the baked headings
+		const VectorRegister4Double Heading = VectorLerpQuat(VectorLoad(&A.Heading.X), VectorLoad(&B.Heading.X), T);
+		VectorStore(VectorNormalizeQuaternion(Heading), &OutRotations[i].X);
+	}
+
+	return true;
+}
+
+bool RogueTrainUtility::SampleTrackBatch(const FRogueTrackSharedFragment& Track, const float VerticalOffsetCm, FTrackBatch& Batch)
+{
+	const int32 Num = Batch.Num();
+	Batch.Locations.SetNumUninitialized(Num, EAllowShrinking::No);
+	Batch.Forwards.SetNumUninitialized(Num, EAllowShrinking::No);
+	Batch.Rotations.SetNumUninitialized(Num, EAllowShrinking::No);
+
+	if (SampleTrackBatch(Track, Batch.Distances, VerticalOffsetCm, Batch.Locations, Batch.Forwards, Batch.Rotations)) return true;
+
+	// No baked table, sample the spline one distance at a time
+	for (int32 i = 0; i < Num; ++i)
+	{
+		FSplineStationSample Sample;
+		if (!GetSplineSample(Track, Batch.Distances[i], 0.f, 0.f, VerticalOffsetCm, Sample)) return false;
+
+		Batch.Locations[i] = Sample.Location;
+		Batch.Forwards[i] = Sample.Forward;
+		Batch.Rotations[i] = FRotationMatrix::MakeFromXZ(Sample.Forward, FVector::UpVector).ToQuat();
+	}
+	
+	return true;
+}
+
 FTransform RogueTrainUtility::SampleTrackFrame(const USplineComponent& Spline, const float Alpha)
 {
 	const float Len = FMath::Max(1.f, Spline.GetSplineLength());
@@ -119,6 +245,7 @@ void RogueTrainUtility::BuildPlatformSegment(const USplineComponent& Spline, con
 	const FVector DockPos = Out.End - Out.Fwd * 200.f;
 	const float DockDist = Spline.GetDistanceAlongSplineAtLocation(DockPos, ESplineCoordinateSpace::World);
 	Out.DockAlpha = (TrackLength > 0.f) ? RogueTrainUtility::WrapTrackAlpha(DockDist / TrackLength) : StationConfigData.TrackAlpha;
+	Out.DockDistance = (TrackLength > 0.f) ? WrapTrackDistance(DockDist, TrackLength) : 0.0;
 
 	// Bake waiting/spawn points aligned to the platform
 	Out.WaitingPoints.Reset();
@@ -148,7 +275,7 @@ void RogueTrainUtility::BuildPlatformSegment(const USplineComponent& Spline, con
 	Out.WaitingGridConfig = StationConfigData.WaitingGridConfig;
 }
 
-void RogueTrainUtility::ComputeConsistPlacement(const FRogueTrackSharedFragment& Track, const float EngineHeadAlpha, const int32 NumCarriages, TArray<FRoguePlacedCar>& Out)
+void RogueTrainUtility::ComputeConsistPlacement(const FRogueTrackSharedFragment& Track, const double EngineHeadDistance, const int32 NumCarriages, TArray<FRoguePlacedCar>& Out)
 {
 	const auto* Settings = GetDefault<URogueDeveloperSettings>();
 	if (!Settings) return;
@@ -156,36 +283,31 @@ void RogueTrainUtility::ComputeConsistPlacement(const FRogueTrackSharedFragment&
 	Out.Reset();
 	if (!Track.IsValid()) return;
 
-	auto WrappedAlpha = [&](const float Dist){ return RogueTrainUtility::WrapTrackAlpha(Dist / Track.TrackLength); };
-
-	// Convert to spline distance
-	const float CarDist = EngineHeadAlpha * Track.TrackLength;
-
-	auto SampleAtDist = [&](const float Dist, const float RideHeight)->FRoguePlacedCar
+	auto SampleAtDist = [&](const double Dist, const float RideHeight)->FRoguePlacedCar
 	{
 		RogueTrainUtility::FSplineStationSample Sample;
-		const float Alpha = WrappedAlpha(Dist);
-		if (!RogueTrainUtility::GetSplineSample(Track, Alpha, Sample))
-			return { Alpha, FTransform::Identity };
+		const double WrappedDist = RogueTrainUtility::WrapTrackDistance(Dist, Track.TrackLength);
+		if (!RogueTrainUtility::GetSplineSample(Track, WrappedDist, Sample))
+			return { WrappedDist, FTransform::Identity };
 
 		const FVector Up = Sample.Up.IsNearlyZero() ? FVector::UpVector : Sample.Up;
 		const FTransform Transform(FQuat::Identity, Sample.Location + Up * RideHeight, FVector::OneVector);
-		return { Alpha, Transform };
+		return { WrappedDist, Transform };
 	};
 
 	// Engine center = head minus half engine length
-	const float EngineCenterDist = CarDist - 0.5f * Settings->EngineLength;
+	const double EngineCenterDist = EngineHeadDistance - 0.5 * Settings->EngineLength;
 	Out.Add(SampleAtDist(EngineCenterDist, Settings->EngineRideHeight));
 
 	// Walk backwards for carriages 
-	float Cursor = EngineCenterDist - 0.5f * Settings->EngineLength - Settings->CarriageSpacing;
+	double Cursor = EngineCenterDist - 0.5 * Settings->EngineLength - Settings->CarriageSpacing;
 	for (int32 i = 0; i < NumCarriages; ++i)
 	{
-		const float CarCenterDist = Cursor - 0.5f * Settings->CarriageLength;
+		const double CarCenterDist = Cursor - 0.5 * Settings->CarriageLength;
 		Out.Add(SampleAtDist(CarCenterDist, Settings->CarriageRideHeight));
 
 		// move next car to rear face and subtract gap
-		Cursor = CarCenterDist - 0.5f * Settings->CarriageLength - Settings->CarriageSpacing;
+		Cursor = CarCenterDist - 0.5 * Settings->CarriageLength - Settings->CarriageSpacing;
 	}
 }
 
@@ -6,9 +6,17 @@
 #include "GameFramework/Actor.h"
 #include "RogueTrainTrack.generated.h"
 
+class UInstancedStaticMeshComponent;
 class USplineMeshComponent;
 class USplineComponent;
 
+UENUM(BlueprintType)
+enum class ERogueTrackBuildMode : uint8
+{
+	SplineMeshes,   // one spline mesh component per span
+	Instanced       // straight spans in one instanced static mesh, curved spans merged into fewer spline meshes
+};
+
 UCLASS()
 class ROGUEMASSEXAMPLE_API ARogueTrainTrack : public AActor
 {
@@ -39,6 +47,38 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Track")
 	float MeshOverlap = 8.f;  
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Track")
+	ERogueTrackBuildMode BuildMode = ERogueTrackBuildMode::SplineMeshes;
+
+	/** Spans turning less than this (degrees) are drawn as instances */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Track", meta=(ClampMin="0", EditCondition="BuildMode==ERogueTrackBuildMode::Instanced"))
+	float StraightToleranceDegrees = 0.5f;
+
+	/** Most curved spans merged into one spline mesh, the mesh is stretched along the merged run */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Track", meta=(ClampMin="1", EditCondition="BuildMode==ERogueTrackBuildMode::Instanced"))
+	int32 MaxMergedSpans = 4;
+
+	/** Curved spans stop merging once the run turns more than this (degrees) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Track", meta=(ClampMin="0", EditCondition="BuildMode==ERogueTrackBuildMode::Instanced"))
+	float MaxMergedTurnDegrees = 10.f;
+
 	UPROPERTY(Transient)
 	TArray<USplineMeshComponent*> TrackSegments;
+
+	UPROPERTY(Transient)
+	UInstancedStaticMeshComponent* TrackInstances = nullptr;
+
+private:
+	struct FTrackSpan
+	{
+		FVector StartPos;
+		FVector EndPos;
+		FVector StartDir;
+		FVector EndDir;
+		FVector MidUp; // spline up at the span midpoint, keeps banked straights rolled with the spline
+	};
+
+	void BuildSpans(TArray<FTrackSpan>& OutSpans) const;
+	void BuildInstancedTrack(const TArray<FTrackSpan>& Spans);
+	USplineMeshComponent* AddSplineMesh(const FVector& StartPos, const FVector& StartDir, const FVector& EndPos, const FVector& EndDir);
 };
@@ -0,0 +1,98 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Mass/Fragments/RogueFragments.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class URogueDeveloperSettings;
+class USplineComponent;
+
+/** One spline control point as stored in the cooked track, component local space */
+struct FRogueCookedSplinePoint
+{
+	FVector Location = FVector::ZeroVector;
+	FVector ArriveTangent = FVector::ZeroVector;
+	FVector LeaveTangent = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	FVector Scale = FVector::OneVector;
+	uint32 PointType = 0;
+};
+
+/** Fixed size file header, section offsets are from the start of the file */
+struct FRogueCookedTrackHeader
+{
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint32 SourceHash = 0;     // settings + source spline the file was baked from
+	uint32 PointStride = 0;    // sizeof checks, the file is only valid for the build layout that wrote it
+	uint32 SampleStride = 0;
+	uint32 NumPoints = 0;
+	uint32 NumSamples = 0;
+	uint32 bClosedLoop = 0;
+	double SampleStep = 0.0;
+	double TrackLength = 0.0;
+	uint64 PointsOffset = 0;
+	uint64 SamplesOffset = 0;
+	uint64 StationsOffset = 0;
+	uint64 StationsSize = 0;
+};
+
+/**
+ * Cooked track data: the resampled and station conditioned spline, platform frames, waiting grids and the baked
+ * sample table. Written by the editor bake (Rogue.BakeTrack) and memory-mapped at runtime, the spline points and
+ * sample table are read in place from the mapping.
+ */
+class ROGUEMASSEXAMPLE_API FRogueCookedTrack
+{
+public:
+	static constexpr uint32 FileMagic = 0x4B525452; // 'RTRK'
+	static constexpr uint32 FileVersion = 4;
+
+	~FRogueCookedTrack();
+
+	/** Hash of everything the cooked data is derived from, a file with a different hash is stale. */
+	static uint32 ComputeSourceHash(const USplineComponent& Spline, const URogueDeveloperSettings& Settings);
+
+	/** Absolute path of the cooked track file from settings. */
+	static FString GetFilename(const URogueDeveloperSettings& Settings);
+
+	/** Maps the file and validates it, returns null if missing, stale or written by a different layout. */
+	static TUniquePtr<FRogueCookedTrack> Load(const FString& Filename, const uint32 ExpectedSourceHash);
+
+	/** Writes a cooked track, Grids holds the waiting grids per station. */
+	static bool Save(
+		const FString& Filename,
+		const uint32 SourceHash,
+		const USplineComponent& Spline,
+		const TArray<FRoguePlatformData>& Platforms,
+		const TArray<FRogueWaitingGrids>& Grids,
+		const FRogueTrackSharedFragment& Track);
+
+	/** Replaces the spline points with the cooked ones, one spline rebuild. */
+	void ApplyToSpline(USplineComponent& Spline) const;
+
+	TConstArrayView<FRogueTrackSample> GetSamples() const { return Samples; }
+	double GetSampleStep() const { return Header.SampleStep; }
+	const TArray<FRoguePlatformData>& GetPlatforms() const { return Platforms; }
+
+	/** Cooked slot positions of a station waiting grid, null if the station or waiting point was not baked */
+	const TArray<FVector>* GetGridSlots(const int32 StationIdx, const int32 WaitingPointIdx) const;
+
+private:
+	FRogueCookedTrack() = default;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	FRogueCookedTrackHeader Header;
+
+	// Views into the mapping
+	TConstArrayView<FRogueCookedSplinePoint> Points;
+	TConstArrayView<FRogueTrackSample> Samples;
+
+	// Variable sized station data, small enough to deserialize
+	TArray<FRoguePlatformData> Platforms;
+	TArray<TArray<TArray<FVector>>> GridSlots;
+};
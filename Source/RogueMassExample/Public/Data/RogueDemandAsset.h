@@ -0,0 +1,55 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Curves/CurveFloat.h"
+#include "Engine/DataAsset.h"
+#include "RogueDemandAsset.generated.h"
+
+USTRUCT(BlueprintType)
+struct FRogueDemandRow
+{
+	GENERATED_BODY()
+
+	/** Trips per simulated hour from this origin to each destination station, the diagonal is ignored */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="0"))
+	TArray<float> TripsPerHour;
+};
+
+/**
+ * Origin-destination passenger demand, rows and columns follow the Stations list in the developer settings
+ * (authoring order), and are remapped to track order station indices when the tables are built.
+ */
+UCLASS(BlueprintType)
+class ROGUEMASSEXAMPLE_API URogueDemandAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** One row per origin station */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Demand")
+	TArray<FRogueDemandRow> Origins;
+
+	/** Demand multiplier over the day, X is the hour [0..24), no keys keeps the matrix rates */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Demand")
+	FRuntimeFloatCurve TimeOfDayScale;
+
+	/** Scales every trip rate, for capacity testing */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Demand", meta=(ClampMin="0"))
+	float DemandScale = 1.f;
+
+	/** Simulated hour at world time zero */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Time", meta=(ClampMin="0", ClampMax="24"))
+	float StartHour = 7.f;
+
+	/** Real seconds per simulated hour, trip rates are compressed by the same factor */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Time", meta=(ClampMin="0.001"))
+	float SecondsPerHour = 60.f;
+
+	float GetTimeOfDayScale(const float WorldSeconds) const;
+
+	// Arrivals per real second for each origin, and each origin's destination CDF flattened row major (NumStations * NumStations).
+	// StationConfigIndices maps each station index to its developer settings Stations entry, i.e. its matrix row and column.
+	void BuildTables(TConstArrayView<int32> StationConfigIndices, TArray<float>& OutOriginRates, TArray<float>& OutDestinationCdf) const;
+};
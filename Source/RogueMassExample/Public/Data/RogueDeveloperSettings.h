@@ -8,6 +8,7 @@
 #include "RogueDeveloperSettings.generated.h"
 
 class UMassEntityConfigAsset;
+class URogueDemandAsset;
 
 
 
@@ -27,18 +28,43 @@ public:
 	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(ClampMin="0"))
 	int32 MaxPassengersOverall = 500;
 
-	/** Interval between spawning new passengers */
+	/** Interval between passenger spawn batches, each batch covers the demand of every station over the interval */
 	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(ClampMin="0"))
 	float SpawnIntervalSeconds = 0.25f;
 
+	/** Passengers arriving per second at each station, unless the station config overrides it. Unused with a demand asset */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(ClampMin="0"))
+	float PassengerDemandRate = 1.f;
+
+	/** Origin-destination demand with a time of day curve, replaces the uniform station rates and random destinations */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings")
+	TSoftObjectPtr<URogueDemandAsset> PassengerDemand = nullptr;
+
 	/** Interval between spawning new passengers */
 	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(ClampMin="0"))
 	float TrackSplineResampleStep = 500.f;
+
+	/** Spacing (cm) of the baked track sample table used by train movement, 0 samples the spline directly */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(ClampMin="0"))
+	float TrackSampleStep = 50.f;
+
+	/** Load the cooked track file at startup instead of resampling and conditioning the spline, falls back if missing or stale */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings")
+	bool bUseCookedTrack = false;
+
+	/** Cooked track file relative to the project Content directory, written in PIE with Rogue.BakeTrack.
+	 *  Stage its folder as non-UFS so it can be memory-mapped in packaged builds. */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Simulation Settings", meta=(EditCondition="bUseCookedTrack"))
+	FString CookedTrackFile = TEXT("RogueTrack/Track.rtrk");
 	
 	/** Maximum number of entities to spawn per frame to avoid hitches */
 	UPROPERTY(EditDefaultsOnly, Config, Category="Spawning", meta=(ClampMin="1"))
 	int32 MaxSpawnsPerFrame = 64;
 
+	/** Maximum number of passengers created per spawn manager tick (every 0.1 s) by batched station spawns, configured through one command flush */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Spawning", meta=(ClampMin="1"))
+	int32 MaxPassengerSpawnsPerTick = 1024;
+
 	/** Train, Carriage and Passenger Settings */
 	
 	/** Number of trains to simulate */
@@ -61,6 +87,18 @@ public:
 	UPROPERTY(EditDefaultsOnly, Config, Category="Trains")
 	float StationApproachSpeed = 250.f;
 
+	/** Split the track into fixed blocks that trains reserve ahead of them, a train never runs into a block held by another */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Signalling")
+	bool bUseBlockSignalling = false;
+
+	/** Length (cm) of one signal block, rounded so the track divides evenly */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Signalling", meta=(ClampMin="100", EditCondition="bUseBlockSignalling"))
+	float SignalBlockLength = 5000.f;
+
+	/** Braking rate (cm/s^2) used to size the reservation ahead of a train and to limit its speed to the blocks it holds */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Signalling", meta=(ClampMin="1", EditCondition="bUseBlockSignalling"))
+	float BrakingDeceleration = 200.f;
+
 	/** Number of carriages per train */
 	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Carriages", meta=(ClampMin="0"))
 	int32 CarriagesPerTrain = 3; 
@@ -105,6 +143,26 @@ public:
 	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers", meta=(ClampMin="0"))
 	float PassengerMaxSpeed = 150.f;
 
+	/** Share of spawned passengers that board ahead of the waiting point queue (accessibility, crew) */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers", meta=(ClampMin="0", ClampMax="1"))
+	float PriorityPassengerChance = 0.f;
+
+	/** Release riding passengers to the pool and keep per destination counts on the carriage, riders are respawned on unload */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers")
+	bool bVirtualizeRiders = false;
+
+	/** Push overlapping passengers apart using the platform spatial hash, on top of the Mass avoidance in the passenger config */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers")
+	bool bUsePassengerSeparation = false;
+
+	/** Spatial hash cell size (cm), around the waiting grid spacing so a query only touches neighbouring cells */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers", meta=(ClampMin="1"))
+	float PassengerSeparationCellSize = 100.f;
+
+	/** Separation force at full overlap, scaled down linearly to zero at touching radii */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Trains|Passengers", meta=(ClampMin="0"))
+	float PassengerSeparationStrength = 500.f;
+
 	/** Acceleration and deceleration rate of the lead carriage */
 	UPROPERTY(EditDefaultsOnly, Config, Category="Stations", meta=(ClampMin="0"))
 	float MaxDwellTimeSeconds = 15.f;
@@ -125,6 +183,18 @@ public:
 	UPROPERTY(EditDefaultsOnly, Config, Category="Stations")
 	float StationArrivalRadius = 50.f;
 
+	/** Cell size (cm) of the platform height grid traced at station creation, passengers snap to it instead of tracing. 0 falls back to traces, staggered by PlatformHeightTraceInterval */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Stations", meta=(ClampMin="0"))
+	float PlatformHeightCellSize = 50.f;
+
+	/** Frames between fallback height traces for a passenger off the platform height grid */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Stations", meta=(ClampMin="1"))
+	int32 PlatformHeightTraceInterval = 4;
+
+	/** Steer walking passengers along flow fields built over the platform height grid, needs a PlatformHeightCellSize. Off by default, passengers walk straight to their target */
+	UPROPERTY(EditDefaultsOnly, Config, Category="Stations")
+	bool bUsePassengerFlowFields = false;
+
 	// Station / Train / Passenger templates
 	UPROPERTY(EditDefaultsOnly, Config, Category="Entity Templates")
 	TSoftObjectPtr<UMassEntityConfigAsset> StationConfig = nullptr;
@@ -15,6 +15,10 @@ USTRUCT() struct ROGUEMASSEXAMPLE_API FRogueTrainStationTag : public FMassTag {
 USTRUCT() struct ROGUEMASSEXAMPLE_API FRogueTrainPassengerTag : public FMassTag { GENERATED_BODY() };
 USTRUCT() struct ROGUEMASSEXAMPLE_API FRoguePooledEntityTag : public FMassTag { GENERATED_BODY() };
 
+// Passenger phases with nothing to do per frame, kept out of the passenger movement and height queries
+USTRUCT() struct ROGUEMASSEXAMPLE_API FRoguePassengerQueuedTag : public FMassTag { GENERATED_BODY() };
+USTRUCT() struct ROGUEMASSEXAMPLE_API FRoguePassengerRidingTag : public FMassTag { GENERATED_BODY() };
+
 UENUM()
 enum class ERoguePassengerPhase : uint8
 {
@@ -83,10 +87,12 @@ struct FRogueStationWaitingGridConfig
 {
 	GENERATED_BODY()
 	
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="0"))
+	// A waiting point holds at most 64 slots (see FRogueWaitingGrids), each axis can use all of them on its own.
+	// Rows past Cols * Rows = 64 are dropped with a warning when the grid is built
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="1", ClampMax="64"))
 	int32 GridCols = 4;
 	
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="0"))
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="1", ClampMax="64"))
 	int32 GridRows = 2;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta=(ClampMin="0"))
@@ -117,20 +123,70 @@ struct FRogueStationConfig
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly)
 	FRogueStationWaitingGridConfig WaitingGridConfig;
+
+	// Passengers arriving per second at this station, negative uses PassengerDemandRate from the developer settings
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	float PassengerDemandRate = -1.f;
+
+	// Lines serving this station, empty is line 0. A station on several lines is an interchange
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	TArray<int32> Lines;
 };
 
+/**
+ * Waiting grids of every waiting point at a station, stored back to back. Grid i owns slots [SlotStarts[i], SlotStarts[i + 1]),
+ * at most 64 of them, with one occupancy bit each so claiming a slot is a count trailing zeros and a bit flip. Slots whose
+ * passenger has arrived are kept in a ring per grid, in arrival order, so boarding pops the front without any scan.
+ * Priority passengers board ahead of the ring, see RoguePassengerQueueUtility.
+ */
 USTRUCT()
-struct FRogueWaitingGrid
+struct ROGUEMASSEXAMPLE_API FRogueWaitingGrids
 {
 	GENERATED_BODY()
 
+	static constexpr int32 MaxSlotsPerGrid = 64;
+
 	/** World-space slots centers, created once when stations are built */
 	TArray<FVector> SlotPositions;
 
-	/** Who is in each slot, or invalid if free */
+	/** Who is in each slot, only meaningful where the occupancy bit is set */
 	TArray<FMassEntityHandle> OccupiedBy;
 
-	FORCEINLINE bool IsValidSlotIndex(const int32 Idx) const { return SlotPositions.IsValidIndex(Idx); }
+	TArray<int32> SlotStarts; // per grid plus one end offset
+	TArray<uint64> Occupancy; // per grid, bit set when the slot is taken
+
+	TArray<uint64> ReadyMasks; // per grid, bit set while the slot is in the ready ring
+	TArray<uint8> ReadyRing; // MaxSlotsPerGrid slot indices per grid
+	TArray<uint8> ReadyHeads;
+	TArray<uint8> ReadyCounts;
+
+	FORCEINLINE int32 Num() const { return Occupancy.Num(); }
+	FORCEINLINE bool IsValidIndex(const int32 Grid) const { return Occupancy.IsValidIndex(Grid); }
+	FORCEINLINE int32 GetNumSlots(const int32 Grid) const { return IsValidIndex(Grid) ? SlotStarts[Grid + 1] - SlotStarts[Grid] : 0; }
+	FORCEINLINE bool IsValidSlotIndex(const int32 Grid, const int32 Slot) const { return Slot >= 0 && Slot < GetNumSlots(Grid); }
+	FORCEINLINE int32 GetNumOccupied(const int32 Grid) const { return IsValidIndex(Grid) ? FMath::CountBits(Occupancy[Grid]) : 0; }
+	FORCEINLINE const FVector& GetSlotPosition(const int32 Grid, const int32 Slot) const { return SlotPositions[SlotStarts[Grid] + Slot]; }
+	FORCEINLINE FMassEntityHandle GetOccupant(const int32 Grid, const int32 Slot) const { return OccupiedBy[SlotStarts[Grid] + Slot]; }
+	TConstArrayView<FVector> GetSlotPositions(const int32 Grid) const
+	{
+		return IsValidIndex(Grid) ? TConstArrayView<FVector>(SlotPositions.GetData() + SlotStarts[Grid], GetNumSlots(Grid)) : TConstArrayView<FVector>();
+	}
+
+	void Reset();
+	// Appends the grid of the next waiting point, slots past MaxSlotsPerGrid are dropped
+	void AddGrid(TConstArrayView<FVector> Slots);
+	// Lowest free slot, INDEX_NONE when the grid is full
+	int32 Claim(const int32 Grid, const FMassEntityHandle Passenger);
+	// Also drops the slot from the ready ring
+	void Release(const int32 Grid, const int32 Slot);
+
+	// Passenger in Slot reached it and can board, false if the slot is free or already ready
+	bool PushReady(const int32 Grid, const int32 Slot);
+	// Longest waiting ready slot, INDEX_NONE when nobody is ready
+	FORCEINLINE int32 PeekReady(const int32 Grid) const
+	{
+		return (IsValidIndex(Grid) && ReadyCounts[Grid] > 0) ? ReadyRing[Grid * MaxSlotsPerGrid + ReadyHeads[Grid]] : INDEX_NONE;
+	}
 };
 
 USTRUCT()
@@ -142,8 +198,10 @@ struct ROGUEMASSEXAMPLE_API FRoguePassengerQueueEntry
 	FMassEntityHandle Passenger = FMassEntityHandle();
 	FMassEntityHandle DestStation = FMassEntityHandle();
 	int32 WaitingPointIdx = INDEX_NONE;
+	int32 WaitingSlotIdx = INDEX_NONE;
 	float EnqueuedGameTime = 0.f;
 	int32 Priority = 0;
+	uint32 Sequence = 0; // enqueue order, keeps equal priority and time first in first out
 };
 
 USTRUCT()
@@ -155,16 +213,79 @@ struct FStationRef
 	FMassEntityHandle Entity;
 };
 
+/** Platform surface heights traced once at station creation, a grid in the platform frame */
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRoguePlatformHeightField
+{
+	GENERATED_BODY()
+
+	FVector Origin = FVector::ZeroVector; // world position of cell (0, 0)
+	FVector AxisX = FVector::ForwardVector;
+	FVector AxisY = FVector::RightVector;
+	float InvCellSize = 0.f;
+	int32 NumX = 0;
+	int32 NumY = 0;
+	TArray<float> Heights; // NumX * NumY, X fastest, MAX_flt where the trace missed
+
+	FORCEINLINE bool IsValid() const { return NumX > 1 && NumY > 1 && Heights.Num() == NumX * NumY; }
+
+	// Bilinear height under Position, false when off the grid or next to a missed cell
+	bool SampleHeight(const FVector& Position, float& OutZ) const;
+};
+
+/** Breadth first flow fields over the platform height grid, one per waiting point and a last one towards the exit spawns */
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRoguePlatformFlowFields
+{
+	GENERATED_BODY()
+
+	static constexpr uint8 NoDirection = 0xFF;
+	static constexpr int8 OffsetX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	static constexpr int8 OffsetY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+	int32 NumCells = 0;
+	int32 NumFields = 0;
+	TArray<uint8> Directions; // NumFields * NumCells, neighbour towards the goal, NoDirection inside the goal or unreachable
+
+	FORCEINLINE bool IsValid() const { return NumFields > 0 && Directions.Num() == NumFields * NumCells; }
+	FORCEINLINE int32 GetExitField() const { return NumFields - 1; }
+
+	// Walking direction at Position, false when off the grid, inside the goal or unreachable
+	bool SampleDirection(const FRoguePlatformHeightField& Grid, const int32 Field, const FVector& Position, FVector& OutDirection) const;
+};
+
+/** Points sorted by their coordinate along the platform, nearest lookups binary search instead of scanning every point */
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRoguePlatformLineIndex
+{
+	GENERATED_BODY()
+
+	FVector Origin = FVector::ZeroVector;
+	FVector Axis = FVector::ForwardVector;
+	TArray<float> Keys; // ascending, projection of each point onto Axis
+	TArray<int32> PointIndices; // point index per key
+
+	void Build(const TArray<FVector>& Points, const FVector& InOrigin, const FVector& InAxis);
+
+	// Same result as a linear scan over Points, INDEX_NONE when empty or built from a different point list
+	int32 FindNearest(const TArray<FVector>& Points, const FVector& From) const;
+};
+
 USTRUCT()
 struct ROGUEMASSEXAMPLE_API FRogueStationQueueFragment : public FMassFragment
 {
 	GENERATED_BODY()
 
-	TMap<int32, TArray<FRoguePassengerQueueEntry>> QueuesByWaitingPoint;
-	TMap<int32, FRogueWaitingGrid> Grids;
+	TArray<TArray<FRoguePassengerQueueEntry>> QueuesByWaitingPoint; // priority boarding heap per waiting point, see RoguePassengerQueueUtility
+	uint32 NextQueueSequence = 0;
+	FRogueWaitingGrids Grids; // indexed by waiting point
 	TArray<FVector> WaitingPoints;
 	TArray<FVector> SpawnPoints; 
 	FRogueStationWaitingGridConfig WaitingGridConfig;
+	FRoguePlatformHeightField PlatformHeights;
+	FRoguePlatformFlowFields FlowFields;
+	FRoguePlatformLineIndex WaitingPointLine;
+	FRoguePlatformLineIndex SpawnPointLine;
 };
 
 USTRUCT()
@@ -182,23 +303,40 @@ struct FRoguePlatformData
 	FVector Right = FVector::RightVector;
 	FVector Up = FVector::UpVector;
 	float DockAlpha = 0.f;
+	double DockDistance = 0.0; // cm along the track
 	float TrackOffset = 0.f;
 	float PlatformLength = 1000.f;
 	EPlatformSide TrackSide = EPlatformSide::Auto;
 	
 	FTransform World = FTransform::Identity;
 	float Alpha = 0.f;   // normalized [0..1]
+	int32 ConfigIndex = INDEX_NONE; // entry of the developer settings Stations list, platforms themselves are in track order
 	TArray<FVector> WaitingPoints;
 	TArray<FVector> SpawnPoints;
 	FRogueStationWaitingGridConfig WaitingGridConfig;
 };
 
+/** One entry of the baked track table, world space frame at a fixed arc-length step along the spline */
+USTRUCT()
+struct FRogueTrackSample
+{
+	GENERATED_BODY()
+
+	FVector Location = FVector::ZeroVector;
+	FVector Forward = FVector::ForwardVector;
+	FVector Right = FVector::RightVector;
+	FVector Up = FVector::UpVector;
+	FQuat Rotation = FQuat::Identity;
+	FQuat Heading = FQuat::Identity; // Forward + world up, the frame vehicles are drawn with
+};
+
 USTRUCT()
 struct ROGUEMASSEXAMPLE_API FRogueTrainTrackFollowFragment : public FMassFragment
 {
 	GENERATED_BODY()
 	
-	float Alpha = 0.f; // [0..1] along spline
+	double Distance = 0.0; // cm along the track, authoritative position (double so long lines keep cm precision)
+	float Alpha = 0.f; // [0..1] along spline, derived from Distance
 	float Speed = 0.f;  // cm/s
 	FVector WorldPos = FVector::ZeroVector;
 	FVector WorldFwd = FVector::ForwardVector;
@@ -222,10 +360,12 @@ struct ROGUEMASSEXAMPLE_API FRogueTrainStateFragment : public FMassFragment
 	bool bAtStation = false;
 	ERogueStationTrainPhase StationTrainPhase = ERogueStationTrainPhase::NotStopped;
 	float HeadwaySpeedScale = 1.f;
+	float SignalSpeedLimit = TNumericLimits<float>::Max(); // cm/s, set by the signal pass from the blocks held ahead
 	float StationTimeRemaining = 0.f;  
-	float PrevAlpha = 0.f;  
+	double PrevDistance = 0.0; // cm along the track last tick
 	int32 TargetStationIdx = INDEX_NONE;
 	int32 PreviousStationIdx = INDEX_NONE;
+	int32 TrainIndex = INDEX_NONE; // dense index into the subsystem per-train arrays
 	float TrainLength = 0.f;
 	TArray<FMassEntityHandle> Carriages;
 };
@@ -236,19 +376,50 @@ struct ROGUEMASSEXAMPLE_API FRogueTrainLinkFragment : public FMassFragment
 	GENERATED_BODY()
 	
 	FMassEntityHandle LeadHandle;
+	int32 TrainIndex = INDEX_NONE; // lead train dense index, see FRogueTrainStateFragment::TrainIndex
 	int32 CarriageIndex = 0; // 0 reserved for lead
 	float Spacing = 8.f;
 };
 
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRogueRiderCount
+{
+	GENERATED_BODY()
+	
+	FMassEntityHandle DestinationStation = FMassEntityHandle();
+	int32 RouteIndex = INDEX_NONE;
+	int32 Count = 0;
+};
+
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRogueOccupantBucket
+{
+	GENERATED_BODY()
+	
+	FMassEntityHandle DestinationStation = FMassEntityHandle();
+	TArray<FMassEntityHandle> Passengers;
+};
+
 USTRUCT()
 struct ROGUEMASSEXAMPLE_API FRogueCarriageFragment : public FMassFragment
 {
 	GENERATED_BODY()
 	
 	int32 Capacity = 100;
-	TArray<FMassEntityHandle> Occupants;
+	TArray<FRogueOccupantBucket> OccupantBuckets; // riders with an entity, bucketed by destination, emptied buckets are kept for reuse
+	int32 NumOccupants = 0;
+	TArray<FRogueRiderCount> VirtualRiders; // riders without an entity, counted per destination
+	int32 NumVirtualRiders = 0;
 	float NextAllowedUnloadTime = 0.f;
-	int32 UnloadCursor = 0; 
+	TArray<int32> WaitingPointOrder; // docked station waiting points nearest first, built on first load, cleared on departure
+
+	FORCEINLINE int32 GetNumRiders() const { return NumOccupants + NumVirtualRiders; }
+	FORCEINLINE FRogueOccupantBucket* FindOccupantBucket(const FMassEntityHandle Station)
+	{
+		return OccupantBuckets.FindByPredicate([&](const FRogueOccupantBucket& Bucket) { return Bucket.DestinationStation == Station; });
+	}
+	void AddOccupant(const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation);
+	bool RemoveOccupant(const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation);
 };
 
 USTRUCT()
@@ -257,9 +428,11 @@ struct ROGUEMASSEXAMPLE_API FRoguePassengerFragment : public FMassFragment
 	GENERATED_BODY()
 	
 	FMassEntityHandle OriginStation = FMassEntityHandle();       
-	FMassEntityHandle DestinationStation = FMassEntityHandle();
+	FMassEntityHandle DestinationStation = FMassEntityHandle(); // end of the current leg
+	int32 RouteIndex = INDEX_NONE; // final station index, next legs come from URogueRouteSubsystem. INDEX_NONE is a single leg
 	int32 WaitingPointIdx = INDEX_NONE;
 	int32 WaitingSlotIdx = INDEX_NONE;
+	int32 BoardingPriority = 0; // higher boards first at a waiting point
 	FMassEntityHandle VehicleHandle;
 	ERoguePassengerPhase Phase = ERoguePassengerPhase::ToStationWaitingPoint;
 	FVector Target = FVector::ZeroVector;
@@ -284,9 +457,33 @@ struct ROGUEMASSEXAMPLE_API FRogueTrackSharedFragment : public FMassSharedFragme
 	TWeakObjectPtr<USplineComponent> Spline;
 	TArray<TPair<float, FMassEntityHandle>> StationEntities;
 	TArray<FRoguePlatformData> Platforms;
-	float TrackLength = 100000.f;
+	double TrackLength = 100000.0;
+
+	// Baked track table, Samples[i] sits at i * SampleStep cm, last entry sits at TrackLength.
+	// Read-only once built so it is safe to sample from any thread. Storage is owned by the train subsystem
+	// (baked at startup or mapped from the cooked track file).
+	TConstArrayView<FRogueTrackSample> Samples;
+	double SampleStep = 0.0;
+	double InvSampleStep = 0.0;
+
+	// Station dock distances in cm sorted ascending, with the station index of each entry
+	TArray<double> SortedDockDistances;
+	TArray<int32> SortedDockStations;
+
+	// Platform center alpha per station index, cached at build so lookups never query the spline
+	TArray<float> StationAlphas;
+
+	// Fixed signal blocks, block i covers [i * BlockLength, (i + 1) * BlockLength) cm. No blocks when signalling is off.
+	double BlockLength = 0.0;
+	int32 NumBlocks = 0;
 
 	FORCEINLINE bool IsValid() const { return Spline.IsValid() && TrackLength > 0.f && StationEntities.Num() == Platforms.Num(); }
+	FORCEINLINE bool HasSamples() const { return Samples.Num() > 1 && InvSampleStep > 0.0; }
+	FORCEINLINE bool HasBlocks() const { return NumBlocks > 1 && BlockLength > 0.0; }
+	FORCEINLINE int32 GetBlockIndex(const double Distance) const
+	{
+		return FMath::Clamp(FMath::FloorToInt32(Distance / BlockLength), 0, NumBlocks - 1);
+	}
 	FORCEINLINE FMassEntityHandle GetStationEntityByIndex(const int32 Index) const
 	{
 		return StationEntities.IsValidIndex(Index) ? StationEntities[Index].Value : FMassEntityHandle();
@@ -313,7 +510,7 @@ struct ROGUEMASSEXAMPLE_API FRogueTrackSharedFragment : public FMassSharedFragme
 
 struct FRoguePlacedCar
 {
-	float Alpha;
+	double Distance; // car center, cm along the track
 	FTransform Transform;
 };
 
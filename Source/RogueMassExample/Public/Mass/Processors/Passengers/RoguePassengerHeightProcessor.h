@@ -22,4 +22,5 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 	FMassEntityQuery EntityQuery;
+	uint32 FrameCounter = 0; // staggers fallback traces for passengers off the platform height grid
 };
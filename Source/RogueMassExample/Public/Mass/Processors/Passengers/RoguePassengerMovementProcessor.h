@@ -9,6 +9,7 @@
 #include "Mass/Fragments/RogueFragments.h"
 #include "RoguePassengerMovementProcessor.generated.h"
 
+class URogueRouteSubsystem;
 class URogueTrainWorldSubsystem;
 
 /**
@@ -30,12 +31,17 @@ protected:
 
 private:
 	static void AssignWaitingPoint(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment, const FMassEntityHandle& Entity);
-	static void MoveToTarget(const FRoguePassengerFragment& PassengerFragment, FMassMoveTargetFragment& MoveTarget, const FMassMovementParameters& MoveParams,const FTransform& PTransform, const FVector& TargetDestination);
-	static void ToStationWaitingPoint(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment,
+	static bool SampleFlowDirection(const FMassEntityManager& EntityManager, const FRoguePassengerFragment& PassengerFragment, const FVector& Location, FVector& OutDirection);
+	static void MoveToTarget(const FRoguePassengerFragment& PassengerFragment, FMassMoveTargetFragment& MoveTarget, const FMassMovementParameters& MoveParams,const FTransform& PTransform,
+		const FVector& TargetDestination, const FVector* FlowDirection = nullptr);
+	static void ToStationWaitingPoint(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
 		const FTransform& PTransform, const FMassEntityHandle PassengerHandle, const float Time);
-	static void ToAssignedCarriage(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
+	static void ToAssignedCarriage(const FMassEntityManager& EntityManager, URogueTrainWorldSubsystem& TrainSubsystem, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
 		const FTransform& PTransform, const FMassEntityHandle PassengerHandle);
-	static void UnloadAtStation(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment, const FTransform& PTransform);
+	static void UnloadAtStation(const FMassEntityManager& EntityManager, const URogueRouteSubsystem& RouteSubsystem, const FRogueTrackSharedFragment& TrackSharedFragment,
+		FRoguePassengerFragment& PassengerFragment, const FTransform& PTransform);
+	static bool StartNextLeg(const FMassEntityManager& EntityManager, const URogueRouteSubsystem& RouteSubsystem, const FRogueTrackSharedFragment& TrackSharedFragment,
+		FRoguePassengerFragment& PassengerFragment);
 	static void ToPostUnloadWaitingPoint(const FMassEntityManager& EntityManager, FRoguePassengerFragment& PassengerFragment,
 		const FTransform& PTransform);
 	static void ToExitSpawn(const FMassEntityManager& EntityManager, URogueTrainWorldSubsystem& TrainSubsystem, const FMassExecutionContext& Context, FRoguePassengerFragment& PassengerFragment,
@@ -0,0 +1,36 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "Utilities/RogueSpatialHash.h"
+#include "RoguePassengerSeparationProcessor.generated.h"
+
+/**
+ * Passenger to passenger separation on platforms. Walking passengers are pushed out of each other and out of queued
+ * passengers on the same platform, which act as fixed obstacles.
+ */
+UCLASS()
+class ROGUEMASSEXAMPLE_API URoguePassengerSeparationProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+	
+public:
+	URoguePassengerSeparationProcessor();
+	
+protected:
+	virtual void ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager) override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+	FMassEntityQuery EntityQuery;
+
+private:
+	// Flat per frame passenger data, in query order
+	FRogueSpatialHash SpatialHash;
+	TArray<FVector> Positions;
+	TArray<int32> Platforms; // station entity index, the spatial hash scope
+	TArray<float> Radii;
+	TArray<bool> Movable;
+	TArray<FVector> Forces;
+};
@@ -7,7 +7,10 @@
 #include "RoguePassengerSpawnProcessor.generated.h"
 
 class UMassEntityConfigAsset;
+class URogueDemandAsset;
+class URogueDeveloperSettings;
 struct FMassEntityTemplate;
+struct FRogueTrackSharedFragment;
 /**
  * 
  */
@@ -26,5 +29,16 @@ protected:
 	FMassEntityQuery EntityQuery;
 
 private:
+	void BuildDemandTables(const URogueDeveloperSettings& Settings, const URogueDemandAsset* DemandAsset, const FRogueTrackSharedFragment& Track);
+	
 	float SpawnAccumulator = 0.f;
+
+	// Demand by station index, rebuilt when the station count changes
+	TArray<float> OriginRates; // arrivals per second at a time of day scale of 1
+	TArray<float> DestinationCdf; // one normalized row per origin
+	TArray<int32> Arrivals;
+	TArray<int32> StationConfigIndices; // developer settings Stations entry per station index
+	int32 HeadroomCursor = 0; // first station handed a rounding leftover when arrivals are capped
+	int32 DemandStations = 0;
+	FRandomStream DemandStream;
 };
@@ -6,6 +6,8 @@
 #include "MassProcessor.h"
 #include "RogueTrainStationOpsProcessor.generated.h"
 
+struct FRogueStationQueueFragment;
+
 /**
  * 
  */
@@ -22,4 +24,7 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 	FMassEntityQuery EntityQuery;
+
+private:
+	static void BuildWaitingPointOrder(const FRogueStationQueueFragment& StationQueueFragment, const FVector& CarriageLocation, TArray<int32>& Order);
 };
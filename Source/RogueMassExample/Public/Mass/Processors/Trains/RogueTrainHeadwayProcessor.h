@@ -22,4 +22,7 @@ protected:
 	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
 
 	FMassEntityQuery EntityQuery;
+
+	// Per train index, reused across frames
+	TArray<float> HeadwayScales;
 };
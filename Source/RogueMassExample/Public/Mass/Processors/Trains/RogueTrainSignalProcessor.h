@@ -0,0 +1,26 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "RogueTrainSignalProcessor.generated.h"
+
+/**
+ * Fixed block signalling. Each train holds the blocks from its tail up to its braking distance ahead,
+ * and is speed limited so it can always stop before the end of the last block it holds.
+ */
+UCLASS()
+class ROGUEMASSEXAMPLE_API URogueTrainSignalProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+	
+public:
+	URogueTrainSignalProcessor();
+	
+protected:
+	virtual void ConfigureQueries(const TSharedRef<FMassEntityManager>& EntityManager) override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+	FMassEntityQuery EntityQuery;
+};
@@ -0,0 +1,38 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "RogueRouteSubsystem.generated.h"
+
+/**
+ * Journeys across lines. Stations sharing a line are one leg apart, the fewest legs between every pair of stations are
+ * precomputed into a next hop table so a passenger only keeps its final station and a leg cursor.
+ */
+UCLASS()
+class ROGUEMASSEXAMPLE_API URogueRouteSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+	
+public:
+	virtual void Deinitialize() override;
+
+	// Lines serving each station, by station index
+	void BuildRoutes(TConstArrayView<TArray<int32>> StationLines);
+	bool HasRoutes() const { return NumStations > 0; }
+
+	/** Station to alight at on the way from Current to Final, Final itself when no transfer is needed, INDEX_NONE when unreachable */
+	FORCEINLINE int32 GetNextHop(const int32 Current, const int32 Final) const
+	{
+		if (Current < 0 || Final < 0 || Current >= NumStations || Final >= NumStations) return INDEX_NONE;
+		const uint16 Hop = NextHops[Current * NumStations + Final];
+		return Hop == NoHop ? INDEX_NONE : Hop;
+	}
+
+private:
+	static constexpr uint16 NoHop = MAX_uint16;
+	
+	int32 NumStations = 0;
+	TArray<uint16> NextHops; // NumStations * NumStations, row is the current station, column the final one
+};
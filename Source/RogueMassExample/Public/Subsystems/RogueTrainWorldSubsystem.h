@@ -4,7 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "MassEntityTemplate.h"
+#include "Data/RogueCookedTrack.h"
 #include "Mass/Fragments/RogueFragments.h"
+#include "StructUtils/InstancedStruct.h"
 #include "Subsystems/WorldSubsystem.h"
 
 #if WITH_EDITOR
@@ -15,6 +17,8 @@
 
 class ARogueTrainTrack;
 class UMassEntityConfigAsset;
+class URogueDemandAsset;
+class URogueDeveloperSettings;
 class USplineComponent;
 
 UENUM()
@@ -38,6 +42,17 @@ struct ROGUEMASSEXAMPLE_API FRogueStationData
 	FMassEntityHandle StationHandle = FMassEntityHandle();
 };
 
+USTRUCT()
+struct ROGUEMASSEXAMPLE_API FRoguePassengerSpawnPayload
+{
+	GENERATED_BODY()
+
+	FVector Location = FVector::ZeroVector;
+	FMassEntityHandle DestinationStation = FMassEntityHandle();
+	int32 RouteIndex = INDEX_NONE;
+	int32 BoardingPriority = 0;
+};
+
 USTRUCT()
 struct ROGUEMASSEXAMPLE_API FRogueSpawnRequest
 {
@@ -49,7 +64,7 @@ struct ROGUEMASSEXAMPLE_API FRogueSpawnRequest
 
 	// Any
 	FTransform Transform = FTransform::Identity;
-	float StartAlpha = 0.f; 
+	double StartDistance = 0.0; // cm along the track
 
 	// Station
 	FRoguePlatformData PlatformData;
@@ -62,11 +77,14 @@ struct ROGUEMASSEXAMPLE_API FRogueSpawnRequest
 	int32 CarriageCapacity = 20;                 
 
 	// Passenger
+	ERoguePassengerPhase InitialPhase = ERoguePassengerPhase::EnteredWorld;
 	FMassEntityHandle OriginStation = FMassEntityHandle();       
 	FMassEntityHandle DestinationStation = FMassEntityHandle();
+	int32 RouteIndex = INDEX_NONE;
 	int32 WaitingPointIdx = INDEX_NONE;
 	float AcceptanceRadius = 20.f;
 	float MaxSpeed = 200.f;
+	TArray<FRoguePassengerSpawnPayload> PassengerPayloads; // batched spawn, one per passenger in place of Transform/DestinationStation
 
 	// Completion callback
 	TFunction<void(const TArray<FMassEntityHandle>& /*Spawned*/)> OnSpawned = nullptr;
@@ -95,6 +113,8 @@ public:
 	
 	// Queue a spawn using the template you created from Dev Settings
 	void EnqueueSpawns(const FRogueSpawnRequest& Request);
+	void EnqueueSpawns(FRogueSpawnRequest&& Request);
+	int32 GetPendingSpawnCount(const ERogueEntityType Type) const;
 
 	// Pooling (generic)
 	void EnqueueEntityToPool(const FMassEntityHandle Entity, const FMassExecutionContext& Context, const ERogueEntityType Type);
@@ -105,10 +125,30 @@ public:
 	const FMassEntityTemplate* GetTrainTemplate() const;
 	const FMassEntityTemplate* GetCarriageTemplate() const;
 	const FMassEntityTemplate* GetPassengerTemplate() const; 
+	const URogueDemandAsset* GetPassengerDemand() const { return PassengerDemand; }
+	const FMassEntityTemplate* GetTemplateByType(const ERogueEntityType Type) const;
 	
 	TMap<FMassEntityHandle, int32> CarriageCounts;
 	TMap<FMassEntityHandle, TArray<FMassEntityHandle>> LeadToCarriages;
 
+	// Dense per-train data, indexed by TrainIndex on the engine state and carriage link fragments
+	int32 RegisterTrain(const FMassEntityHandle Engine, const double HeadDistance);
+	int32 GetNumTrains() const { return TrainEngines.Num(); }
+	TArrayView<double> GetMutableTrainHeadDistances() { return TrainHeadDistances; }
+	TConstArrayView<double> GetTrainHeadDistances() const { return TrainHeadDistances; }
+	TArrayView<float> GetMutableTrainLengths() { return TrainLengths; }
+
+	// Train indices in ascending head distance, treated as a ring. Trains on a loop rarely overtake,
+	// so the order is only re-sorted when a check finds it broken.
+	TConstArrayView<int32> GetTrainOrder() const { return TrainOrder; }
+	void RepairTrainOrder();
+
+	// Fixed block signalling, each block holds the owning train index or INDEX_NONE. A train holds a contiguous
+	// run of blocks from its tail forward, stored per train as the first block and the number held.
+	TArrayView<int32> GetMutableBlockOwners() { return BlockOwners; }
+	TArrayView<int32> GetMutableTrainFirstBlocks() { return TrainFirstBlocks; }
+	TArrayView<int32> GetMutableTrainHeldBlocks() { return TrainHeldBlocks; }
+
 protected:
 	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
 	void ProcessPendingSpawns();
@@ -125,14 +165,30 @@ private:
 	TArray<FRoguePlatformData> Platforms;
 	TArray<FRogueSpawnRequest> PendingSpawns;
 	FRogueTrackSharedFragment CachedTrack;
+	TArray<FRogueTrackSample> TrackSamples; // storage for CachedTrack.Samples when it is baked at runtime
+	TUniquePtr<FRogueCookedTrack> CookedTrack; // set when the cooked track file was loaded, replaces the startup track build
+	uint32 TrackSourceHash = 0;
 	int32 TrackRevision = 0;
 	bool bTrackDirty = true;
+	TWeakObjectPtr<const USplineComponent> BakedSpline; // spline and length the samples and blocks were baked for
+	double BakedSplineLength = -1.0;
+	bool bTrackConditioned = false; // platform windows applied to the spline, never redone for late station spawns
 	TMap<ERogueEntityType, TArray<FMassEntityHandle>> EntityPool;
 	TMap<ERogueEntityType, TArray<FMassEntityHandle>> WorldEntities;
+	TMap<ERogueEntityType, TArray<FInstancedStruct>> DormantFragments; // stripped from pooled entities, restored on retrieve
+	TArray<FMassEntityHandle> TrainEngines;
+	TArray<double> TrainHeadDistances; // engine head distance along the track in cm, written by the engine movement pass
+	TArray<float> TrainLengths; // engine plus carriages in cm, written by the headway pass
+	TArray<int32> TrainOrder;
+	TArray<int32> BlockOwners;
+	TArray<int32> TrainFirstBlocks;
+	TArray<int32> TrainHeldBlocks;
+	int32 NumVirtualRiders = 0;
 	UPROPERTY() UMassEntityConfigAsset* StationConfig = nullptr;
 	UPROPERTY() UMassEntityConfigAsset* TrainConfig = nullptr;
 	UPROPERTY() UMassEntityConfigAsset* CarriageConfig = nullptr;
 	UPROPERTY() UMassEntityConfigAsset* PassengerConfig = nullptr;
+	UPROPERTY() URogueDemandAsset* PassengerDemand = nullptr;
 	FMassEntityTemplate StationTemplate;  
 	FMassEntityTemplate TrainTemplate;  
 	FMassEntityTemplate CarriageTemplate;  
@@ -147,10 +203,14 @@ private:
 	void DiscoverSplineFromSettings();
 	void GatherStationActors();
 	void CreateStations();
-	void ConfigureTrackToStation(const FRogueSpawnRequest& Request, const float ResampleDistance) const;
+	void ConditionTrackForStations(const float ResampleDistance);
+	void ConfigureTrackToStation(const FRoguePlatformData& PlatformData, const float ResampleDistance, const float SplineLength, const TArray<float>& PointDistances) const;
 	static void GetStationSide(const FRoguePlatformData& PlatformData, const FTransform& StationTransform, float& Out);
 	void BuildStationPlatformData();
 	void CreateTrains();
+	// Samples and signal blocks, only when the spline changed. Station data is cheap and rebuilt on every track build
+	void BakeTrackGeometry(const URogueDeveloperSettings& Settings, const USplineComponent& Spline);
+	void BuildStationSharedData();
 
 	// Cache
 	FMassEntityManager* EntityManager = nullptr;
@@ -164,7 +224,9 @@ private:
 	void ConfigureTrain(const FRogueSpawnRequest& Request, const FMassEntityHandle Entity);
 	void ConfigureCarriage(const FRogueSpawnRequest& Request, const FMassEntityHandle Entity);
 	void ConfigurePassenger(const FRogueSpawnRequest& Request, const FMassEntityHandle Entity);
+	void ConfigurePassengerBatch(const FRogueSpawnRequest& Request, TConstArrayView<FMassEntityHandle> Entities, const int32 NumReused);
 	
+	const TArray<FInstancedStruct>& GetDormantFragments(const ERogueEntityType Type, const FMassEntityHandle Entity);
 	TArray<FMassEntityHandle>& GetEntitiesFromPoolByType(const ERogueEntityType Type) {	return EntityPool.FindOrAdd(Type); }
 	TArray<FMassEntityHandle>& GetEntitiesFromWorldByType(const ERogueEntityType Type) { return WorldEntities.FindOrAdd(Type); }
 
@@ -178,6 +240,10 @@ public:
 	int32 GetTotalLiveCount() const;
 	int32 GetTotalPoolCount() const;
 
+	// Riders held as carriage counts instead of entities, still counted against the passenger cap
+	void AddVirtualRiders(const int32 Delta) { NumVirtualRiders += Delta; }
+	int32 GetVirtualRiderCount() const { return NumVirtualRiders; }
+
 #if WITH_EDITOR
 public:	
 	FORCEINLINE const TArray<FRogueDebugPassenger>& GetPassengerDebugSnapshot() { return PassengersDebugSnapshot; }
@@ -201,6 +267,9 @@ public:
 	FORCEINLINE void SetStationDebugSnapshot(TArray<FRogueDebugStation>&& Snapshot) { StationsDebugSnapshot.Reset(); StationsDebugSnapshot = MoveTemp(Snapshot); }
 
 	FORCEINLINE const TArray<FRogueDebugTrack>& GetTrackDebugSnapshot() { return TracksDebugSnapshot; }
+
+	// Writes the cooked track file from the current track state, all stations must be configured
+	bool BakeCookedTrack();
 	//const USplineComponent& GetTrackEntities() const;
 
 	
@@ -0,0 +1,21 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+namespace RogueDemandUtility
+{
+	/** Poisson distributed count with mean Lambda, exact for small means and normal approximated above 30 */
+	int32 SamplePoisson(const FRandomStream& Stream, const float Lambda);
+
+	/** Arrivals for every station in one pass over the contiguous rate array, OutArrivals[i] ~ Poisson(Rates[i] * Scale * Seconds) */
+	void SampleArrivals(const FRandomStream& Stream, TConstArrayView<float> Rates, const float Scale, const float Seconds, TArrayView<int32> OutArrivals);
+
+	/** Scales arrivals down to Headroom in proportion to each count, rounding leftovers go one each from StartIndex on. Returns the total kept */
+	int32 ShareHeadroom(TArrayView<int32> InOutArrivals, const int32 Headroom, const int32 StartIndex);
+
+	/** Index drawn from a normalized cumulative row, INDEX_NONE when the row is empty */
+	int32 SampleCdf(const FRandomStream& Stream, TConstArrayView<float> CdfRow);
+}
@@ -9,22 +9,41 @@
 
 class URogueTrainWorldSubsystem;
 
+/**
+ * Boarding queue per waiting point. Priority passengers go in a binary heap, highest priority then longest waiting on top,
+ * everyone else in the waiting grid's ready ring in arrival order. Boarding takes the heap before the ring.
+ */
 namespace RoguePassengerQueueUtility
 {
-	void EnqueueAtWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, const FMassEntityHandle Passenger,
+	// One empty heap per waiting grid, reserved to the grid size. Entries leave with their slot, so a heap never outgrows its grid
+	void ResetQueues(FRogueStationQueueFragment& StationQueueFragment);
+	void EnqueueAtWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, const int32 WaitingSlotIdx, const FMassEntityHandle Passenger,
 		const FMassEntityHandle DestStation, const float Time, const int32 Priority = 0);
+	// Next priority passenger to board, nullptr when there is none
+	const FRoguePassengerQueueEntry* PeekWaitingPoint(const FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx);
 	bool DequeueFromWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, FRoguePassengerQueueEntry& Out);	
+	// Drops Passenger from the priority heap, false when it wasn't queued there
+	bool RemoveFromWaitingPoint(FRogueStationQueueFragment& StationQueueFragment, const int32 WaitingPointIdx, const FMassEntityHandle Passenger);
 }
 
 namespace RoguePassengerUtility
 {
     inline bool IsHandleValid(const FMassEntityManager& EntityManager, const FMassEntityHandle EntityHandle) { return EntityHandle.IsSet() && EntityManager.IsEntityValid(EntityHandle); }
+	// Station whose platform the passenger is on: the origin until they get off, the destination after
+	inline FMassEntityHandle GetCurrentStation(const FRoguePassengerFragment& PassengerFragment)
+	{
+		return (PassengerFragment.Phase >= ERoguePassengerPhase::UnloadAtStation) ? PassengerFragment.DestinationStation : PassengerFragment.OriginStation;
+	}
 
-    // Remove passenger at index (swap & pop), clear their tags/vehicle
-    void Disembark(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment, const int32 Index, const FVector& Location);
+    // Remove one rider for Station from its destination bucket, clear their tags/vehicle. False when nobody is left for Station
+    bool Disembark(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment, const FMassEntityHandle Station,
+    	const FVector& Location);
     bool TryBoard(const FMassEntityManager& EntityManager, const FMassExecutionContext& Context, const FMassEntityHandle Passenger, const FMassEntityHandle CarriageEntity, FRogueCarriageFragment& CarriageFragment);
+	// Rider virtualization, see URogueDeveloperSettings::bVirtualizeRiders
+	void VirtualizeRider(URogueTrainWorldSubsystem& TrainSubsystem, const FMassExecutionContext& Context, FRogueCarriageFragment& CarriageFragment,
+		const FMassEntityHandle Passenger, const FMassEntityHandle DestinationStation, const int32 RouteIndex);
+	bool MaterializeRider(URogueTrainWorldSubsystem& TrainSubsystem, FRogueCarriageFragment& CarriageFragment, const FMassEntityHandle Station, const FVector& Location);
 	void HidePassenger(const FMassEntityManager& EntityManager, const FMassEntityHandle EntityHandle);
 	void ShowPassenger(const FMassEntityManager& EntityManager, const FMassEntityHandle EntityHandle, const FVector& ShowLocation);
-	int32 FindNearestIndex(const TArray<FVector>& Points, const FVector& From);
 	bool SnapToPlatform(const UWorld* WorldContext, FVector& InOutPos, float MaxStepUp = 60.f, float MaxDrop = 200.f);
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Uniform XY grid per scope (a platform) hashed into a fixed power of two bucket count. Items are stored bucket sorted in
+ * one flat array with per bucket start offsets, so a neighbour query walks at most nine contiguous ranges. Items of other
+ * scopes are skipped, hash collisions within a scope are possible so callers check distance themselves.
+ */
+struct ROGUEMASSEXAMPLE_API FRogueSpatialHash
+{
+	/** Rebuild from item positions and scopes, the bucket of every item is hashed in parallel */
+	void Build(TConstArrayView<FVector> Positions, TConstArrayView<int32> Scopes, const float InCellSize);
+
+	/** Calls Func(ItemIndex) for every item of Scope in the cells overlapping Radius around Location */
+	template<typename FuncType>
+	void ForEachNearby(const int32 Scope, const FVector& Location, const float Radius, FuncType&& Func) const
+	{
+		if (Items.Num() == 0) return;
+		
+		const int32 MinX = FMath::FloorToInt32((Location.X - Radius) * InvCellSize);
+		const int32 MaxX = FMath::FloorToInt32((Location.X + Radius) * InvCellSize);
+		const int32 MinY = FMath::FloorToInt32((Location.Y - Radius) * InvCellSize);
+		const int32 MaxY = FMath::FloorToInt32((Location.Y + Radius) * InvCellSize);
+
+		// Cells can share a bucket, visit each bucket once
+		TArray<int32, TInlineAllocator<9>> Visited;
+		for (int32 Y = MinY; Y <= MaxY; ++Y)
+		{
+			for (int32 X = MinX; X <= MaxX; ++X)
+			{
+				const int32 Bucket = GetBucket(Scope, X, Y);
+				if (Visited.Contains(Bucket)) continue;
+				Visited.Add(Bucket);
+
+				for (int32 i = BucketStarts[Bucket]; i < BucketStarts[Bucket + 1]; ++i)
+				{
+					if (ItemScopes[i] == Scope) Func(Items[i]);
+				}
+			}
+		}
+	}
+
+	int32 Num() const { return Items.Num(); }
+
+private:
+	FORCEINLINE int32 GetBucket(const int32 Scope, const int32 CellX, const int32 CellY) const
+	{
+		const uint32 Hash = static_cast<uint32>(CellX) * 73856093u ^ static_cast<uint32>(CellY) * 19349663u ^ static_cast<uint32>(Scope) * 83492791u;
+		return static_cast<int32>(Hash & static_cast<uint32>(NumBuckets - 1));
+	}
+
+	float InvCellSize = 0.01f;
+	int32 NumBuckets = 1;
+	TArray<int32> BucketStarts; // NumBuckets + 1 offsets into Items
+	TArray<int32> Items; // item indices sorted by bucket
+	TArray<int32> ItemScopes; // scope per entry of Items
+	TArray<int32> ItemBuckets; // scratch, bucket per item
+	TArray<int32> BucketCursors; // scratch, write offset per bucket
+};
@@ -8,10 +8,13 @@
 
 namespace RogueStationQueueUtility
 {
+	void BuildPlatformHeightField(const UWorld* WorldContext, const FRoguePlatformData& StationSegment, FRogueStationQueueFragment& QueueFragment, const float CellSize);
+	void BuildPlatformFlowFields(FRogueStationQueueFragment& QueueFragment);
 	void BuildGridForWaitingPoint(const FRoguePlatformData& StationSegment, FRogueStationQueueFragment& QueueFragment, const FVector& WaitingCenter, int32 WaitingPointIdx);
 	int32 ClaimWaitingSlot(FRogueStationQueueFragment* QueueFragment, const int32 WaitingPointIdx, const FMassEntityHandle& Passenger, FVector& OutSlotPos);
 	void ReleaseSlot(FRogueStationQueueFragment& QueueFragment, const FRoguePassengerFragment& PassengerFragment);
+	// Frees the slot and takes its passenger out of the boarding queue
+	void ReleaseWaitingSlot(FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx, const int32 SlotIdx);
 	//bool DequeueFromGrid(const FMassEntityManager& EntityManger, FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx, FMassEntityHandle& OutPassenger, int32& OutSlotIdx, FVector& OutSlotPos);
-	bool PeekFromGrid(const FMassEntityManager& EntityManger, FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx,
-		FMassEntityHandle& OutPassenger, const FMassEntityHandle CurrentStationEntity, int32& OutSlotIdx, FVector& OutSlotPos);
+	bool PeekFromGrid(const FRogueStationQueueFragment& QueueFragment, const int32 WaitPointIdx, FMassEntityHandle& OutPassenger, int32& OutSlotIdx, FVector& OutSlotPos);
 }
\ No newline at end of file
@@ -9,7 +9,18 @@
 namespace RogueTrainUtility
 {
 	inline float WrapTrackAlpha(const float Alpha) { return Alpha - FMath::FloorToFloat(Alpha); }
-	int32 FindNextStation(const USplineComponent& Spline,const TArray<FRoguePlatformData>& Platforms, const float CurrentAlpha);
+	inline double WrapTrackDistance(const double Distance, const double TrackLength)
+	{
+		const double Wrapped = FMath::Fmod(Distance, TrackLength);
+		return (Wrapped < 0.0) ? Wrapped + TrackLength : Wrapped;
+	}
+	/** Forward distance in cm from one track position to another, wrapping past the loop end */
+	inline double ForwardDistanceWrapped(const double FromDistance, const double ToDistance, const double TrackLength)
+	{
+		return WrapTrackDistance(ToDistance - FromDistance, TrackLength);
+	}
+	/** Next station dock strictly ahead of CurrentDistance (cm), binary search over the sorted dock distances. */
+	int32 FindNextStation(const FRogueTrackSharedFragment& Track, const double CurrentDistance);
 	float AlphaAtWorld(const USplineComponent& Spline, const FVector& WorldPos);
 	float ArcDistanceWrapped(const float FromAlpha, const float ToAlpha);
 	
@@ -20,13 +31,13 @@ namespace RogueTrainUtility
 		FVector   Right    = FVector::RightVector;
 		FVector   Up       = FVector::UpVector;
 		FTransform World   = FTransform::Identity;
-		float     Distance = 0.f;   // cm along spline
+		double    Distance = 0.0;   // cm along spline
 		float     Alpha        = 0.f;   // normalized [0..1]
 	};
 
 	/** Returns true if sampled successfully.
 	 *  @param Track			Track fragment with spline reference
-	 *  @param StationTrackAlpha         Normalized station T in [0..1]
+	 *  @param Distance			Distance along the track in cm, wrapped to the track length
 	 *  @param AlongOffsetCm    Extra distance along the spline in cm (positive moves forward)
 	 *  @param LateralOffsetCm  Offset to the right of the track (platform side) in cm
 	 *  @param VerticalOffsetCm Vertical offset in cm
@@ -34,20 +45,75 @@ namespace RogueTrainUtility
 	 */
 	bool GetSplineSample(
 		const FRogueTrackSharedFragment& Track,
-		const float StationTrackAlpha,
+		const double Distance,
 		const float AlongOffsetCm,
 		const float LateralOffsetCm,
 		const float VerticalOffsetCm,
 		FSplineStationSample& Out);
 
 	/** Convenience overload: zero offsets */
-	inline bool GetSplineSample(const FRogueTrackSharedFragment& TrackSharedFragment, const float TrackAlpha, FSplineStationSample& Out)
+	inline bool GetSplineSample(const FRogueTrackSharedFragment& TrackSharedFragment, const double Distance, FSplineStationSample& Out)
 	{
-		return GetSplineSample(TrackSharedFragment, TrackAlpha, /*Along*/0.f, /*Lat*/0.f, /*Z*/0.f, Out);
+		return GetSplineSample(TrackSharedFragment, Distance, /*Along*/0.f, /*Lat*/0.f, /*Z*/0.f, Out);
 	}
 
+	/** Bakes a uniformly spaced world space frame table along the spline.
+	 *  @param Spline			Spline to sample, should already be resampled/conditioned
+	 *  @param Step				Requested spacing in cm, adjusted so the table ends exactly on the spline length
+	 *  @param Out				Table output, Out[i] sits at i * OutStep cm
+	 *  @param OutStep			Actual spacing used
+	 */
+	void BuildTrackSamples(const USplineComponent& Spline, const float Step, TArray<FRogueTrackSample>& Out, double& OutStep);
+
+	/** Table lookup + lerp at a distance in cm, distance is wrapped to the track length. Returns false if the table is not baked. */
+	bool SampleTrackTable(const FRogueTrackSharedFragment& Track, const double Distance, FRogueTrackSample& Out);
+
+	/** Samples the baked table for a whole span of distances at once (SIMD lerps), outputs are SoA.
+	 *  @param Track			Track fragment with a baked sample table
+	 *  @param Distances		Distances along the track in cm, wrapped to the track length
+	 *  @param VerticalOffsetCm	Offset along the track up vector in cm (ride height)
+	 *  @param OutLocations		World location per distance
+	 *  @param OutForwards		Track forward per distance
+	 *  @param OutRotations		Heading rotation (forward + world up) per distance
+	 *  @return false if the table is not baked or the outputs are smaller than the input span
+	 */
+	bool SampleTrackBatch(
+		const FRogueTrackSharedFragment& Track,
+		TConstArrayView<double> Distances,
+		const float VerticalOffsetCm,
+		TArrayView<FVector> OutLocations,
+		TArrayView<FVector> OutForwards,
+		TArrayView<FQuat> OutRotations);
+
+	/** Reusable per-chunk buffers for SampleTrackBatch, keeps allocations out of the chunk loop */
+	struct FTrackBatch
+	{
+		TArray<int32> EntityIndices;
+		TArray<double> Distances;
+		TArray<FVector> Locations;
+		TArray<FVector> Forwards;
+		TArray<FQuat> Rotations;
+
+		void Reset(const int32 Reserve)
+		{
+			EntityIndices.Reset(Reserve);
+			Distances.Reset(Reserve);
+		}
+
+		void Add(const int32 EntityIndex, const double Distance)
+		{
+			EntityIndices.Add(EntityIndex);
+			Distances.Add(Distance);
+		}
+
+		int32 Num() const { return Distances.Num(); }
+	};
+
+	/** Convenience overload: sizes the batch outputs and samples every queued distance */
+	bool SampleTrackBatch(const FRogueTrackSharedFragment& Track, const float VerticalOffsetCm, FTrackBatch& Batch);
+
 	FTransform SampleTrackFrame(const USplineComponent& Spline, float Alpha);
 	FVector SampleDockPoint(const USplineComponent& Spline, float Alpha);
 	void BuildPlatformSegment(const USplineComponent& Spline, const FRogueStationConfig& StationConfigData, FRoguePlatformData& Out);
-	void ComputeConsistPlacement(const FRogueTrackSharedFragment& Track, const float EngineHeadAlpha, const int32 NumCarriages, TArray<FRoguePlacedCar>& Out);
+	void ComputeConsistPlacement(const FRogueTrackSharedFragment& Track, const double EngineHeadDistance, const int32 NumCarriages, TArray<FRoguePlacedCar>& Out);
 }